@@ -0,0 +1,166 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Bytes that live in an Arena, an EpgCache mapping or some other storage
+// that outlives the reference. Plain data, copying it copies the pointer.
+struct ArenaString {
+	const char* data_;
+	uint32_t size_;
+
+	const char* data() const { return data_; }
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	const uint8_t* bytes() const { return reinterpret_cast<const uint8_t*>(data_); }
+	std::string str() const { return std::string(data_, size_); }
+
+	bool operator == (ArenaString const& s) const {
+		return size_ == s.size_ && memcmp(data_, s.data_, size_) == 0;
+	}
+};
+
+inline ArenaString arena_string(const void* p, size_t n) {
+	ArenaString s = {n ? static_cast<const char*>(p) : "", uint32_t(n)};
+	return s;
+}
+
+// Allocates from large blocks and frees them all at once: everything
+// decoded from one batch of input goes in, and goes away with it.
+class Arena {
+public:
+	explicit Arena(size_t block_size = 64*1024) : block_size_(block_size), used_(0), free_(0), bytes_(0) {}
+
+	~Arena() {
+		clear();
+	}
+
+	void* alloc(size_t n, size_t align = 8) {
+		size_t pad = (align - used_ % align) % align;
+		if(blocks_.empty() || pad + n > free_) {
+			// larger requests get a block of their own, the current one stays in use
+			if(n > block_size_ / 4) {
+				void* p = block(n);
+				if(blocks_.size() > 1)
+					std::swap(blocks_[blocks_.size() - 1], blocks_[blocks_.size() - 2]);
+				return p;
+			}
+			block(block_size_);
+			used_ = 0;
+			free_ = block_size_;
+			pad = 0;
+		}
+		char* p = blocks_.back() + used_ + pad;
+		used_ += pad + n;
+		free_ -= pad + n;
+		return p;
+	}
+
+	ArenaString copy(const void* p, size_t n) {
+		if(!n)
+			return arena_string(0, 0);
+		char* d = static_cast<char*>(alloc(n, 1));
+		memcpy(d, p, n);
+		return arena_string(d, n);
+	}
+
+	ArenaString copy(std::string const& s) { return copy(s.data(), s.size()); }
+
+	// Frees every block
+	void clear() {
+		for(size_t i = 0; i < blocks_.size(); ++i)
+			free(blocks_[i]);
+		blocks_.clear();
+		used_ = free_ = 0;
+		bytes_ = 0;
+	}
+
+	void swap(Arena& a) {
+		blocks_.swap(a.blocks_);
+		std::swap(block_size_, a.block_size_);
+		std::swap(used_, a.used_);
+		std::swap(free_, a.free_);
+		std::swap(bytes_, a.bytes_);
+	}
+
+	// Bytes taken from the system
+	size_t bytes() const { return bytes_; }
+
+private:
+	Arena(Arena const&);
+	Arena& operator = (Arena const&);
+
+	char* block(size_t n) {
+		char* p = static_cast<char*>(malloc(n));
+		if(!p)
+			throw std::bad_alloc();
+		blocks_.push_back(p);
+		bytes_ += n;
+		return p;
+	}
+
+	std::vector<char*> blocks_;
+	size_t block_size_;
+	// of the last block
+	size_t used_;
+	size_t free_;
+	size_t bytes_;
+};
+
+// Keeps one copy of each value in an arena. Meant for what repeats from
+// event to event and service to service: language codes, provider and
+// series names, genre text.
+class StringPool {
+public:
+	explicit StringPool(Arena& arena) : arena_(&arena) {}
+
+	ArenaString intern(const void* p, size_t n) {
+		if(!n)
+			return arena_string(0, 0);
+		Strings::const_iterator i = strings_.find(arena_string(p, n));
+		if(i != strings_.end())
+			return *i;
+		ArenaString s = arena_->copy(p, n);
+		strings_.insert(s);
+		return s;
+	}
+
+	ArenaString intern(std::string const& s) { return intern(s.data(), s.size()); }
+
+	// Forgets every value, for when the arena is cleared
+	void clear() { strings_.clear(); }
+
+	// Swaps the values only, each pool keeps its arena: swap the arenas too
+	void swap(StringPool& p) {
+		strings_.swap(p.strings_);
+	}
+
+	size_t size() const { return strings_.size(); }
+
+private:
+	// FNV-1a
+	struct Hash {
+		size_t operator () (ArenaString const& s) const {
+			uint64_t h = 14695981039346656037ull;
+			for(uint32_t i = 0; i < s.size_; ++i)
+				h = (h ^ uint8_t(s.data_[i])) * 1099511628211ull;
+			return h;
+		}
+	};
+
+	typedef std::unordered_set<ArenaString, Hash> Strings;
+
+	Arena* arena_;
+	Strings strings_;
+};
+
+#endif
@@ -0,0 +1,329 @@
+#ifndef _CHANDB_H_
+#define _CHANDB_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "section.h"
+#include "descriptors.h"
+#include "servicescan.h"
+#include "scancache.h"
+#include "epg.h"
+
+// Channel database: the complete scans of every multiplex seen, kept in a
+// ScanCache file (the one channel-scan -c writes), and the services they
+// describe indexed by original_network_id, transport_stream_id and
+// service_id (epg_service_key()). Sections come in one multiplex at a
+// time; once its tables are complete they are compared with the stored
+// scan by version, and only a multiplex with a changed table is stored
+// again and has its services decoded again.
+
+struct ChannelStream {
+	uint8_t type_;
+	uint16_t pid_;
+
+	bool operator == (ChannelStream const& s) const { return type_ == s.type_ && pid_ == s.pid_; }
+};
+
+struct ChannelCa {
+	uint16_t system_id_;
+	uint16_t pid_;
+
+	bool operator == (ChannelCa const& c) const { return system_id_ == c.system_id_ && pid_ == c.pid_; }
+};
+
+struct Channel {
+	uint16_t original_network_id_;
+	uint16_t transport_stream_id_;
+	uint16_t service_id_;
+	// 0 for a service of the SDT the PAT does not list
+	uint16_t pmt_pid_;
+	uint16_t pcr_pid_;
+	// service_descriptor, 0 and empty without one
+	uint8_t service_type_;
+	std::string provider_;
+	std::string name_;
+	uint8_t running_status_;
+	bool free_ca_mode_;
+	std::vector<ChannelStream> streams_;
+	// CA_descriptors of the program and of its streams
+	std::vector<ChannelCa> ca_;
+
+	Channel() : original_network_id_(0), transport_stream_id_(0), service_id_(0), pmt_pid_(0), pcr_pid_(0),
+		service_type_(0), running_status_(0), free_ca_mode_(false) {}
+
+	uint64_t key() const { return epg_service_key(original_network_id_, transport_stream_id_, service_id_); }
+
+	// First video stream and the vtype mwatch takes for it, 0 if there is none
+	uint16_t video_pid(const char*& type) const {
+		for(size_t i = 0; i < streams_.size(); ++i) {
+			switch(streams_[i].type_) {
+			case 0x01: case 0x02: type = "mpeg2"; return streams_[i].pid_;
+			case 0x1b: type = "h264"; return streams_[i].pid_;
+			}
+		}
+		type = "?";
+		return 0;
+	}
+
+	// First MPEG audio stream, else the first other audio stream, 0 if none
+	uint16_t audio_pid() const {
+		uint16_t other = 0;
+		for(size_t i = 0; i < streams_.size(); ++i) {
+			switch(streams_[i].type_) {
+			case 0x03: case 0x04: return streams_[i].pid_;
+			case 0x0f: case 0x11: case 0x81: if(!other) other = streams_[i].pid_; break;
+			}
+		}
+		return other;
+	}
+
+	bool operator == (Channel const& c) const {
+		return key() == c.key() && pmt_pid_ == c.pmt_pid_ && pcr_pid_ == c.pcr_pid_ && service_type_ == c.service_type_
+			&& provider_ == c.provider_ && name_ == c.name_ && running_status_ == c.running_status_
+			&& free_ca_mode_ == c.free_ca_mode_ && streams_ == c.streams_ && ca_ == c.ca_;
+	}
+};
+
+struct ChannelDbStats {
+	uint64_t sections_;
+	// multiplexes whose tables came in complete, and those that did not
+	uint64_t multiplexes_;
+	uint64_t incomplete_;
+	// complete multiplexes with every table in the stored version
+	uint64_t unchanged_;
+	// tables new or in another version than stored
+	uint64_t tables_changed_;
+	// services
+	uint64_t added_;
+	uint64_t removed_;
+	uint64_t changed_;
+};
+
+class ChannelDb {
+public:
+	typedef std::map<uint64_t, Channel> Channels;
+
+	ChannelDb() : pat_tsid_(-1), completed_tsid_(-1), stats_() {}
+
+	// True if the file was read or does not exist
+	bool load(const char* path) {
+		if(!cache_.load(path))
+			return false;
+		channels_.clear();
+		deliveries_.clear();
+		for(std::map<TransportKey, ServiceScan>::const_iterator i = cache_.scans().begin(); i != cache_.scans().end(); ++i)
+			index(i->second, false);
+		return true;
+	}
+
+	bool save(const char* path) const { return cache_.save(path); }
+
+	// A section of the multiplex being received, with its PID and the time
+	// it came in. A PAT of another transport_stream_id starts the next
+	// multiplex.
+	void add(uint16_t pid, const uint8_t* s, size_t n, uint64_t now) {
+		++stats_.sections_;
+		if(pid == 0x00 && n >= 8 && s[0] == 0x00 && (s[1] & 0x80)) {
+			int tsid = s[3] << 8 | s[4];
+			if(pat_tsid_ >= 0 && tsid != pat_tsid_)
+				finish();
+			pat_tsid_ = tsid;
+		}
+		scan_.add(pid, s, n, now);
+		if(scan_.complete())
+			finish();
+	}
+
+	// Ends the multiplex being received, at the end of the input. Returns
+	// the tables still missing if it is incomplete, "" otherwise.
+	std::string finish() {
+		ServiceScan scan;
+		std::swap(scan, scan_);
+		int tsid = pat_tsid_;
+		pat_tsid_ = -1;
+
+		if(!scan.complete()) {
+			// the tables of a multiplex just stored, repeating until the input ended
+			if(tsid < 0 || tsid == completed_tsid_)
+				return std::string();
+			++stats_.incomplete_;
+			return scan.missing();
+		}
+
+		++stats_.multiplexes_;
+		completed_tsid_ = scan.transport_stream_id();
+		ServiceScan const* old = cache_.find(transport_key(scan));
+		std::vector<ScanVersion> versions = scan.versions();
+		size_t changed = old ? changed_tables(old->versions(), versions) : versions.size();
+		if(!changed) {
+			++stats_.unchanged_;
+			return std::string();
+		}
+
+		stats_.tables_changed_ += changed;
+		cache_.put(scan);
+		index(*cache_.find(transport_key(scan)), true);
+		return std::string();
+	}
+
+	Channels const& channels() const { return channels_; }
+
+	Channel const* find(uint64_t key) const {
+		Channels::const_iterator i = channels_.find(key);
+		return i == channels_.end() ? 0 : &i->second;
+	}
+
+	// First service with this name
+	Channel const* find(std::string const& name) const {
+		for(Channels::const_iterator i = channels_.begin(); i != channels_.end(); ++i)
+			if(i->second.name_ == name)
+				return &i->second;
+		return 0;
+	}
+
+	// The transponder a NIT gives for the multiplex, false if none or DVB-S2
+	bool transponder(Channel const& c, Transponder& t) const {
+		std::map<TransportKey, Transponder>::const_iterator i = deliveries_.find(TransportKey(c.original_network_id_, c.transport_stream_id_));
+		if(i == deliveries_.end())
+			return false;
+		t = i->second;
+		return true;
+	}
+
+	size_t multiplexes() const { return cache_.size(); }
+	ChannelDbStats const& stats() const { return stats_; }
+
+private:
+	// Tables in one list and not in the other, or in another version; both sorted
+	static size_t changed_tables(std::vector<ScanVersion> const& a, std::vector<ScanVersion> const& b) {
+		size_t changed = 0, i = 0, j = 0;
+		while(i < a.size() || j < b.size()) {
+			if(j == b.size() || (i < a.size() && a[i] < b[j]))
+				++i, ++changed;
+			else if(i == a.size() || b[j] < a[i])
+				++j, ++changed;
+			else
+				changed += a[i++].version_ != b[j++].version_;
+		}
+		return changed;
+	}
+
+	struct Builder {
+		uint16_t onid_;
+		uint16_t tsid_;
+		Channels& out_;
+		std::string buf_;
+
+		void operator () (uint16_t id, uint16_t pmt_pid, std::vector<ByteView> const& pmt, SdtService const* s) {
+			Channel c;
+			c.original_network_id_ = onid_;
+			c.transport_stream_id_ = tsid_;
+			c.service_id_ = id;
+			c.pmt_pid_ = pmt_pid;
+
+			for(size_t i = 0; i < pmt.size(); ++i) {
+				PmtSection section(pmt[i]);
+				if(i == 0) {
+					c.pcr_pid_ = section.pcr_pid();
+					add_ca(c, section.descriptors());
+				}
+				Loop<PmtStream> streams = section.streams();
+				for(Loop<PmtStream>::iterator j = streams.begin(); j != streams.end(); ++j) {
+					PmtStream es = *j;
+					ChannelStream cs = {es.stream_type(), es.pid()};
+					c.streams_.push_back(cs);
+					add_ca(c, es.descriptors());
+				}
+			}
+
+			if(s) {
+				c.running_status_ = s->running_status();
+				c.free_ca_mode_ = s->free_ca_mode();
+				Descriptor d((ByteView()));
+				if(find_descriptor(s->descriptors(), 0x48, d)) {
+					ServiceDescriptor sd(d);
+					c.service_type_ = sd.service_type();
+					c.provider_ = text(sd.provider_name(), buf_);
+					c.name_ = text(sd.service_name(), buf_);
+				}
+			}
+			out_[c.key()] = c;
+		}
+
+		static void add_ca(Channel& c, DescriptorLoop const& loop) {
+			for(DescriptorLoop::iterator i = loop.begin(); i != loop.end(); ++i) {
+				Descriptor d = *i;
+				if(d.tag() != 0x09)
+					continue;
+				CaDescriptor ca(d);
+				ChannelCa cc = {ca.ca_system_id(), ca.ca_pid()};
+				c.ca_.push_back(cc);
+			}
+		}
+	};
+
+	// Decodes the services of a scan in place of those stored for its
+	// multiplex and the transponders of its NIT
+	void index(ServiceScan const& scan, bool count) {
+		uint16_t onid = scan.original_network_id(), tsid = scan.transport_stream_id();
+		Channels::iterator first = channels_.lower_bound(epg_service_key(onid, tsid, 0));
+		Channels::iterator last = channels_.upper_bound(epg_service_key(onid, tsid, 0xFFFF));
+		Channels old(first, last);
+		channels_.erase(first, last);
+
+		Channels now;
+		try {
+			Builder b = {onid, tsid, now};
+			scan.services(b);
+		}
+		catch(SectionError const&) {
+			// ServiceScan kept sections that passed their CRC, a loop in one of them is broken
+		}
+		channels_.insert(now.begin(), now.end());
+
+		if(count) {
+			for(Channels::const_iterator i = now.begin(); i != now.end(); ++i) {
+				Channels::const_iterator o = old.find(i->first);
+				if(o == old.end())
+					++stats_.added_;
+				else if(!(o->second == i->second))
+					++stats_.changed_;
+			}
+			for(Channels::const_iterator o = old.begin(); o != old.end(); ++o)
+				stats_.removed_ += !now.count(o->first);
+		}
+
+		std::vector<ByteView> sections = scan.nit().views();
+		try {
+			for(size_t i = 0; i < sections.size(); ++i) {
+				Loop<NitTransport> transports = NitSection(sections[i]).transports();
+				for(Loop<NitTransport>::iterator j = transports.begin(); j != transports.end(); ++j) {
+					NitTransport ts = *j;
+					TransportKey key(ts.original_network_id(), ts.transport_stream_id());
+					Descriptor d((ByteView()));
+					Transponder t;
+					if(find_descriptor(ts.descriptors(), 0x43, d) && delivery_transponder(SatelliteDeliveryDescriptor(d), t))
+						deliveries_[key] = t;
+				}
+			}
+		}
+		catch(SectionError const&) {
+		}
+	}
+
+	ScanCache cache_;
+	Channels channels_;
+	std::map<TransportKey, Transponder> deliveries_;
+	// the multiplex being received and the transport_stream_id of its PAT, -1 before one
+	ServiceScan scan_;
+	int pat_tsid_;
+	int completed_tsid_;
+	ChannelDbStats stats_;
+};
+
+#endif
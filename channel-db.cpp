@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "secstream.h"
+#include "json.h"
+#include "record.h"
+#include "chandb.h"
+
+void usage() {
+	fprintf(stderr, "usage: channel-db -d database [-u] [-b | -l | -t service | -m service] [< sections]\n"
+		"\tkeeps the services of every multiplex seen, by original_network_id, transport_stream_id\n"
+		"\tand service_id; the database is a cache file of channel-scan -c and can be one\n"
+		"\t-u\tupdate the database from sections framed by sec-collect, ts2sec -F or channel-scan -c\n"
+		"\t\ton stdin, one multiplex after the other; a multiplex is stored again only if one\n"
+		"\t\tof its tables has a version other than the stored one\n"
+		"\t-b\tbinary records instead of JSON, see record.h\n"
+		"\t-l\tchannel list, one service per line, tab separated: onid:tsid:sid, the arguments\n"
+		"\t\tof tuneqpsk, the line mwatch reads on stdin, name; control characters in names,\n"
+		"\t\ttabs and line breaks among them, are printed as spaces\n"
+		"\t-t\tprint the tuneqpsk arguments of a service: FREQ POL SYMRATE FEC\n"
+		"\t-m\tprint the line mwatch reads on stdin for a service: VPID VTYPE APID\n"
+		"\tservice is onid:tsid:sid or the name of a service; without -u, -l, -t or -m one\n"
+		"\trecord per service is printed, with -u only if -b is given\n");
+	exit(1);
+}
+
+enum Mode { RECORDS, LIST, TUNE, WATCH, NONE };
+
+template<class Out>
+void write_channel(Out& os, ChannelDb const& db, Channel const& c, std::string& buf) {
+	os.begin(RECORD_CHANNEL);
+	os.number("original_network_id", c.original_network_id_);
+	os.number("transport_stream_id", c.transport_stream_id_);
+	os.number("service_id", c.service_id_);
+	os.number("service_type", c.service_type_);
+	os.text("provider", c.provider_);
+	os.text("name", c.name_);
+	os.number("running_status", c.running_status_);
+	os.flag("free_CA_mode", c.free_ca_mode_);
+	os.number("pmt_pid", c.pmt_pid_);
+	os.number("pcr_pid", c.pcr_pid_);
+
+	os.array("streams");
+	for(size_t i = 0; i < c.streams_.size(); ++i) {
+		os.object();
+		os.number("type", c.streams_[i].type_);
+		os.number("pid", c.streams_[i].pid_);
+		os.end_object();
+	}
+	os.end_array();
+
+	os.array("ca");
+	for(size_t i = 0; i < c.ca_.size(); ++i) {
+		os.object();
+		os.number("CA_system_id", c.ca_[i].system_id_);
+		os.number("CA_PID", c.ca_[i].pid_);
+		os.end_object();
+	}
+	os.end_array();
+
+	// zeros and empty strings for a multiplex no NIT gives a DVB-S transponder for
+	Transponder t = {0, 0, 0, ""};
+	bool tunable = db.transponder(c, t);
+	os.number("frequency", t.frequency_);
+	buf.assign(tunable ? 1 : 0, t.polarization_);
+	os.text("polarization", buf);
+	os.number("symbol_rate", t.symbol_rate_);
+	buf = t.fec_;
+	os.text("fec", buf);
+	os.end();
+}
+
+template<class Out>
+void write_channels(JsonWriter& out, ChannelDb const& db, bool newline) {
+	Out os(out);
+	std::string buf;
+	for(ChannelDb::Channels::const_iterator i = db.channels().begin(); i != db.channels().end(); ++i) {
+		write_channel(os, db, i->second, buf);
+		if(newline)
+			out << '\n';
+		out.flush(false);
+	}
+}
+
+// "FREQ POL SYMRATE FEC", false if there is no transponder for the service
+bool tune_args(ChannelDb const& db, Channel const& c, char* buf, size_t size) {
+	Transponder t;
+	if(!db.transponder(c, t))
+		return false;
+	snprintf(buf, size, "%u %c %u %s", t.frequency_, t.polarization_, t.symbol_rate_, t.fec_);
+	return true;
+}
+
+// "VPID VTYPE APID"
+void watch_line(Channel const& c, char* buf, size_t size) {
+	const char* vtype;
+	uint16_t vpid = c.video_pid(vtype);
+	snprintf(buf, size, "%u %s %u", vpid, vtype, c.audio_pid());
+}
+
+// A name for a field of the channel list: TAB, CR, LF and the other C0
+// and C1 control characters become spaces
+std::string const& list_field(std::string const& name, std::string& buf) {
+	buf.clear();
+	for(size_t i = 0; i < name.size(); ++i) {
+		uint8_t c = name[i];
+		// C1 controls are U+0080 to U+009F, 0xC2 0x80 to 0xC2 0x9F in UTF-8
+		if(c == 0xC2 && i + 1 < name.size() && (uint8_t(name[i + 1]) & 0xE0) == 0x80) {
+			buf += ' ';
+			++i;
+		}
+		else
+			buf += c < 0x20 || c == 0x7F ? ' ' : char(c);
+	}
+	return buf;
+}
+
+Channel const* find_service(ChannelDb const& db, const char* s) {
+	int onid, tsid, sid;
+	char tail;
+	if(sscanf(s, "%i:%i:%i%c", &onid, &tsid, &sid, &tail) == 3)
+		return db.find(epg_service_key(onid, tsid, sid));
+	return db.find(std::string(s));
+}
+
+int main(int argc, char* argv[]) {
+	const char* path = 0;
+	const char* service = 0;
+	bool update = false;
+	bool binary = false;
+	Mode mode = RECORDS;
+	bool mode_given = false;
+
+	int opt;
+	while((opt = getopt(argc, argv, "d:ublt:m:")) != -1) {
+		switch(opt) {
+		case 'd': path = optarg; break;
+		case 'u': update = true; break;
+		case 'b': binary = true; mode = RECORDS; mode_given = true; break;
+		case 'l': mode = LIST; mode_given = true; break;
+		case 't': mode = TUNE; service = optarg; mode_given = true; break;
+		case 'm': mode = WATCH; service = optarg; mode_given = true; break;
+		default: usage();
+		}
+	}
+	if(!path || optind != argc)
+		usage();
+	if(update && !mode_given)
+		mode = NONE;
+
+	ChannelDb db;
+	if(!db.load(path)) {
+		perror(path);
+		return 1;
+	}
+
+	if(update) {
+		SectionStream in(STDIN_FILENO, true);
+		const uint8_t* s;
+		size_t n;
+		secframe f;
+		std::string missing;
+
+		try {
+			while(in.next(s, n, &f)) {
+				db.add(f.pid, s, n, f.timestamp);
+			}
+		}
+		catch(std::exception const& e) {
+			fprintf(stderr, "channel-db: %s\n", e.what());
+		}
+		missing = db.finish();
+		if(!missing.empty())
+			fprintf(stderr, "channel-db: last multiplex incomplete: %s\n", missing.c_str());
+
+		ChannelDbStats const& st = db.stats();
+		fprintf(stderr, "channel-db: %llu sections, %llu multiplexes, %llu unchanged, %llu incomplete, %llu tables changed, "
+			"%llu services added, %llu changed, %llu removed\n",
+			(unsigned long long)st.sections_, (unsigned long long)st.multiplexes_, (unsigned long long)st.unchanged_,
+			(unsigned long long)st.incomplete_, (unsigned long long)st.tables_changed_,
+			(unsigned long long)st.added_, (unsigned long long)st.changed_, (unsigned long long)st.removed_);
+
+		if(st.tables_changed_ && !db.save(path)) {
+			perror(path);
+			return 1;
+		}
+	}
+
+	JsonWriter out;
+	char buf[128];
+	std::string name;
+	switch(mode) {
+	case RECORDS:
+		if(binary)
+			write_channels<BinaryRecord>(out, db, false);
+		else
+			write_channels<JsonRecord>(out, db, true);
+		break;
+
+	case LIST:
+		for(ChannelDb::Channels::const_iterator i = db.channels().begin(); i != db.channels().end(); ++i) {
+			Channel const& c = i->second;
+			out << (uint32_t)c.original_network_id_ << ':' << (uint32_t)c.transport_stream_id_ << ':' << (uint32_t)c.service_id_ << '\t';
+			out << (tune_args(db, c, buf, sizeof(buf)) ? buf : "-") << '\t';
+			watch_line(c, buf, sizeof(buf));
+			out << buf << '\t' << list_field(c.name_, name) << '\n';
+			out.flush(false);
+		}
+		break;
+
+	case TUNE:
+	case WATCH: {
+		Channel const* c = find_service(db, service);
+		if(!c) {
+			fprintf(stderr, "channel-db: %s: no such service\n", service);
+			return 1;
+		}
+		if(mode == TUNE) {
+			if(!tune_args(db, *c, buf, sizeof(buf))) {
+				fprintf(stderr, "channel-db: %s: no DVB-S transponder known\n", service);
+				return 1;
+			}
+		}
+		else
+			watch_line(*c, buf, sizeof(buf));
+		out << buf << '\n';
+		break;
+	}
+
+	case NONE:
+		break;
+	}
+
+	out.flush();
+	return out.good() ? 0 : 1;
+}
@@ -0,0 +1,398 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "json.h"
+#include "record.h"
+#include "descriptors.h"
+#include "servicescan.h"
+#include "demuxscan.h"
+#include "scancache.h"
+
+static volatile sig_atomic_t g_stop = 0;
+
+void sighandler(int n) {
+	g_stop = 1;
+}
+
+void usage() {
+	fprintf(stderr, "usage: channel-scan [-b] [-c cache] [-t seconds] [-a adapter[:frontend]]... [-T tuneqpsk] [-l N] [-L LNB] [-s DISEQC] FREQ POL SYMRATE FEC\n"
+		"\tscans the transponder given as mux-scan does, then every transponder its NIT lists\n"
+		"\tin a satellite_delivery_system_descriptor, and those their NITs list; each multiplex\n"
+		"\tis scanned once per original_network_id and transport_stream_id and written as mux-scan writes it\n"
+		"\t-a\tfrontend to scan with, demuxN of adapterN is used with frontendN, default 0:0;\n"
+		"\t\tgiven more than once the frontends scan different transponders at the same time\n"
+		"\t-c\tcache file: multiplexes scanned while the NIT had the version it has now are taken\n"
+		"\t\tfrom it instead of being tuned, the cache is updated after the scan\n"
+		"\t-T\ttuneqpsk to tune with, default tuneqpsk in PATH\n"
+		"\t-l, -L, -s\tpassed to tuneqpsk, -l defaults to 25\n"
+		"\t-t\tgive up on missing tables of a multiplex after this many seconds, default 30\n"
+		"\t-b\tbinary records instead of JSON, see record.h\n"
+		"\tFREQ\tkHz, POL, SYMRATE and FEC as for tuneqpsk\n");
+	exit(1);
+}
+
+struct Options {
+	const char* tuneqpsk_;
+	const char* attempts_;
+	const char* lnb_;
+	const char* diseqc_;
+	uint64_t timeout_;
+};
+
+struct Frontend {
+	int adapter_;
+	int frontend_;
+};
+
+// A transponder to scan; 'known_' is false for the first one, whose
+// multiplex is only known after the scan
+struct Job {
+	Transponder transponder_;
+	TransportKey key_;
+	bool known_;
+};
+
+// The queue of transponders shared by the frontend threads. A multiplex
+// enters it once, when the first NIT listing it is complete.
+class ChannelScan {
+public:
+	explicit ChannelScan(ScanCache const& cache) : cache_(cache), active_(0), cached_(0), dvbs2_(0) {
+		pthread_mutex_init(&mutex_, 0);
+		pthread_cond_init(&changed_, 0);
+	}
+
+	~ChannelScan() {
+		pthread_cond_destroy(&changed_);
+		pthread_mutex_destroy(&mutex_);
+	}
+
+	void seed(Transponder const& t) {
+		Job job = {t, TransportKey(0, 0), false};
+		queue_.push_back(job);
+	}
+
+	// Waits for a transponder to scan, false once the queue is empty and
+	// no scan running can add to it, or on g_stop
+	bool next(Job& job) {
+		pthread_mutex_lock(&mutex_);
+		while(!g_stop && queue_.empty() && active_) {
+			// signals do not wake a condition wait, so look at g_stop now and then
+			timespec t;
+			clock_gettime(CLOCK_REALTIME, &t);
+			t.tv_sec += 1;
+			pthread_cond_timedwait(&changed_, &mutex_, &t);
+		}
+		bool r = !g_stop && !queue_.empty();
+		if(r) {
+			job = queue_.front();
+			queue_.pop_front();
+			++active_;
+		}
+		pthread_mutex_unlock(&mutex_);
+		return r;
+	}
+
+	// The scan of the job's transponder, 0 if it could not be tuned
+	void done(Job const& job, ServiceScan const* scan) {
+		pthread_mutex_lock(&mutex_);
+		if(!scan || (!job.known_ && scan->transport_stream_id() == 0))
+			failed_.push_back(job.transponder_);
+		else {
+			TransportKey key = job.known_ ? job.key_ : transport_key(*scan);
+			if(!results_.count(key)) {
+				results_[key] = *scan;
+				seen_.insert(key);
+				if(scan->nit().complete())
+					add_transports(*scan);
+			}
+		}
+		--active_;
+		pthread_cond_broadcast(&changed_);
+		pthread_mutex_unlock(&mutex_);
+	}
+
+	std::map<TransportKey, ServiceScan> const& results() const { return results_; }
+	std::vector<Transponder> const& failed() const { return failed_; }
+	unsigned cached() const { return cached_; }
+	unsigned dvbs2() const { return dvbs2_; }
+
+private:
+	ChannelScan(ChannelScan const&);
+	ChannelScan& operator = (ChannelScan const&);
+
+	// Queues the transports of the NIT not seen yet, or takes their scans
+	// from the cache if the NIT has not changed since
+	void add_transports(ServiceScan const& scan) {
+		std::vector<ByteView> sections = scan.nit().views();
+		for(size_t i = 0; i < sections.size(); ++i) {
+			try {
+				Loop<NitTransport> transports = NitSection(sections[i]).transports();
+				for(Loop<NitTransport>::iterator j = transports.begin(); j != transports.end(); ++j) {
+					NitTransport ts = *j;
+					TransportKey key(ts.original_network_id(), ts.transport_stream_id());
+					if(seen_.count(key))
+						continue;
+
+					Descriptor d((ByteView()));
+					if(!find_descriptor(ts.descriptors(), 0x43, d))
+						continue;
+					seen_.insert(key);
+
+					if(ServiceScan const* cached = cache_.find(key, scan.network_id(), scan.nit_version())) {
+						results_[key] = *cached;
+						++cached_;
+						add_transports(*cached);
+						continue;
+					}
+
+					Job job = {Transponder(), key, true};
+					if(delivery_transponder(SatelliteDeliveryDescriptor(d), job.transponder_))
+						queue_.push_back(job);
+					else
+						++dvbs2_;
+				}
+			}
+			catch(SectionError const& e) {
+				fprintf(stderr, "channel-scan: NIT %u: %s\n", scan.network_id(), e.what());
+			}
+		}
+	}
+
+	ScanCache const& cache_;
+	std::deque<Job> queue_;
+	// multiplexes queued, scanned or taken from the cache
+	std::set<TransportKey> seen_;
+	std::map<TransportKey, ServiceScan> results_;
+	std::vector<Transponder> failed_;
+	unsigned active_;
+	unsigned cached_;
+	unsigned dvbs2_;
+
+	pthread_mutex_t mutex_;
+	pthread_cond_t changed_;
+};
+
+// Runs tuneqpsk and waits for it to report the lock
+bool tune(Options const& o, Frontend const& fe, Transponder const& t) {
+	char adapter[16], frontend[16], frequency[16], polarization[2] = {t.polarization_, 0}, symbol_rate[16];
+	snprintf(adapter, sizeof(adapter), "%d", fe.adapter_);
+	snprintf(frontend, sizeof(frontend), "%d", fe.frontend_);
+	snprintf(frequency, sizeof(frequency), "%u", t.frequency_);
+	snprintf(symbol_rate, sizeof(symbol_rate), "%u", t.symbol_rate_);
+
+	std::vector<const char*> argv;
+	argv.push_back(o.tuneqpsk_);
+	argv.push_back("-q");
+	argv.push_back("-x");
+	argv.push_back("-l");
+	argv.push_back(o.attempts_);
+	argv.push_back("-a");
+	argv.push_back(adapter);
+	argv.push_back("-f");
+	argv.push_back(frontend);
+	if(o.lnb_) {
+		argv.push_back("-L");
+		argv.push_back(o.lnb_);
+	}
+	if(o.diseqc_) {
+		argv.push_back("-s");
+		argv.push_back(o.diseqc_);
+	}
+	argv.push_back(frequency);
+	argv.push_back(polarization);
+	argv.push_back(symbol_rate);
+	argv.push_back(t.fec_);
+	argv.push_back(0);
+
+	pid_t pid = fork();
+	if(pid < 0) {
+		perror("fork");
+		return false;
+	}
+	if(pid == 0) {
+		execvp(argv[0], const_cast<char* const*>(&argv[0]));
+		_exit(127);
+	}
+
+	int status;
+	while(waitpid(pid, &status, 0) < 0)
+		if(errno != EINTR)
+			return false;
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+struct FrontendThread {
+	Frontend frontend_;
+	Options const* options_;
+	ChannelScan* scan_;
+	pthread_t thread_;
+};
+
+void* frontend_thread(void* arg) {
+	FrontendThread* t = reinterpret_cast<FrontendThread*>(arg);
+	char device[64];
+	snprintf(device, sizeof(device), "/dev/dvb/adapter%d/demux%d", t->frontend_.adapter_, t->frontend_.frontend_);
+
+	Job job;
+	while(t->scan_->next(job)) {
+		Transponder const& tp = job.transponder_;
+		if(!tune(*t->options_, t->frontend_, tp)) {
+			fprintf(stderr, "channel-scan: %d:%d: no lock on %u %c %u %s\n", t->frontend_.adapter_, t->frontend_.frontend_,
+				tp.frequency_, tp.polarization_, tp.symbol_rate_, tp.fec_);
+			t->scan_->done(job, 0);
+			continue;
+		}
+
+		ServiceScan scan;
+		if(scan_demux(device, scan, t->options_->timeout_, g_stop) != 0) {
+			t->scan_->done(job, 0);
+			continue;
+		}
+		if(!scan.complete())
+			fprintf(stderr, "channel-scan: %u %c: incomplete: %s\n", tp.frequency_, tp.polarization_, scan.missing().c_str());
+		t->scan_->done(job, &scan);
+	}
+	return 0;
+}
+
+template<class Out>
+void write_results(JsonWriter& os, std::map<TransportKey, ServiceScan> const& results, bool lines) {
+	Out rec(os);
+	DescriptorRegistry<Out> descriptors;
+	add_scan_descriptors(descriptors);
+	for(std::map<TransportKey, ServiceScan>::const_iterator i = results.begin(); i != results.end(); ++i) {
+		size_t mark = os.size();
+		try {
+			i->second.write(rec, descriptors);
+			if(lines)
+				os << '\n';
+		}
+		catch(std::exception const& e) {
+			os.truncate(mark);
+			fprintf(stderr, "channel-scan: skipping multiplex %u:%u: %s\n", i->first.first, i->first.second, e.what());
+		}
+		os.flush(false);
+	}
+}
+
+bool parse_frontend(const char* s, Frontend& fe) {
+	char* end;
+	fe.adapter_ = strtol(s, &end, 10);
+	fe.frontend_ = 0;
+	if(end == s)
+		return false;
+	if(*end == ':') {
+		s = end + 1;
+		fe.frontend_ = strtol(s, &end, 10);
+		if(end == s)
+			return false;
+	}
+	return *end == 0;
+}
+
+int main(int argc, char* argv[]) {
+	Options options = {"tuneqpsk", "25", 0, 0, 30 * 1000000ull};
+	std::vector<Frontend> frontends;
+	const char* cache_file = 0;
+	bool binary = false;
+
+	int opt;
+	while((opt = getopt(argc, argv, "a:bc:l:L:s:t:T:")) != -1) {
+		switch(opt) {
+		case 'a': {
+			Frontend fe;
+			if(!parse_frontend(optarg, fe))
+				usage();
+			frontends.push_back(fe);
+			break;
+		}
+		case 'b': binary = true; break;
+		case 'c': cache_file = optarg; break;
+		case 'l': options.attempts_ = optarg; break;
+		case 'L': options.lnb_ = optarg; break;
+		case 's': options.diseqc_ = optarg; break;
+		case 't': {
+			int seconds = atoi(optarg);
+			if(seconds <= 0)
+				usage();
+			options.timeout_ = seconds * 1000000ull;
+			break;
+		}
+		case 'T': options.tuneqpsk_ = optarg; break;
+		default: usage();
+		}
+	}
+
+	if(argc - optind != 4)
+		usage();
+
+	Transponder seed;
+	seed.frequency_ = strtoul(argv[optind], 0, 10);
+	seed.polarization_ = argv[optind + 1][0];
+	seed.symbol_rate_ = strtoul(argv[optind + 2], 0, 10);
+	seed.fec_ = argv[optind + 3];
+	if(!strchr("HVLR", seed.polarization_) || !seed.frequency_ || !seed.symbol_rate_)
+		usage();
+
+	if(frontends.empty()) {
+		Frontend fe = {0, 0};
+		frontends.push_back(fe);
+	}
+
+	ScanCache cache;
+	if(cache_file && !cache.load(cache_file)) {
+		perror(cache_file);
+		return 1;
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sighandler;
+	sigaction(SIGTERM, &sa, 0);
+	sigaction(SIGINT, &sa, 0);
+
+	ChannelScan scan(cache);
+	scan.seed(seed);
+
+	std::vector<FrontendThread> threads(frontends.size());
+	for(size_t i = 0; i < threads.size(); ++i) {
+		threads[i].frontend_ = frontends[i];
+		threads[i].options_ = &options;
+		threads[i].scan_ = &scan;
+		pthread_create(&threads[i].thread_, 0, frontend_thread, &threads[i]);
+	}
+	for(size_t i = 0; i < threads.size(); ++i)
+		pthread_join(threads[i].thread_, 0);
+
+	JsonWriter out;
+	if(binary)
+		write_results<BinaryRecord>(out, scan.results(), false);
+	else
+		write_results<JsonRecord>(out, scan.results(), true);
+	out.flush();
+
+	if(cache_file) {
+		for(std::map<TransportKey, ServiceScan>::const_iterator i = scan.results().begin(); i != scan.results().end(); ++i)
+			cache.put(i->second);
+		if(!g_stop && !cache.save(cache_file))
+			perror(cache_file);
+	}
+
+	fprintf(stderr, "channel-scan: %zu multiplexes, %u from the cache, %zu transponders failed, %u DVB-S2 transponders skipped\n",
+		scan.results().size(), scan.cached(), scan.failed().size(), scan.dvbs2());
+	return scan.failed().empty() && !g_stop ? 0 : 2;
+}
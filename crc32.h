@@ -0,0 +1,63 @@
+#ifndef _CRC32_H_
+#define _CRC32_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-32/MPEG-2 (polynomial 0x04C11DB7, not reflected, initial value
+// 0xFFFFFFFF, no final xor) as used by PSI/SI sections. Running it over a
+// whole section including the trailing CRC_32 field yields 0.
+//
+// Slice-by-8: eight 256 entry tables let the loop consume 8 bytes per
+// iteration with independent lookups instead of one byte at a time.
+class Crc32Mpeg {
+public:
+	static uint32_t update(uint32_t crc, const uint8_t* p, size_t n) {
+		Tables const& t = tables();
+
+		for(; n >= 8; n -= 8, p += 8) {
+			uint32_t a = crc ^ ((uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+			uint32_t b = (uint32_t(p[4]) << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+			crc = t.t_[7][a >> 24] ^ t.t_[6][(a >> 16) & 0xFF] ^ t.t_[5][(a >> 8) & 0xFF] ^ t.t_[4][a & 0xFF]
+				^ t.t_[3][b >> 24] ^ t.t_[2][(b >> 16) & 0xFF] ^ t.t_[1][(b >> 8) & 0xFF] ^ t.t_[0][b & 0xFF];
+		}
+
+		for(; n; --n)
+			crc = (crc << 8) ^ t.t_[0][(crc >> 24) ^ *p++];
+
+		return crc;
+	}
+
+	static uint32_t compute(const uint8_t* p, size_t n) {
+		return update(0xFFFFFFFF, p, n);
+	}
+
+	// True if the section including its CRC_32 field is intact
+	static bool check(const uint8_t* section, size_t length) {
+		return length >= 4 && compute(section, length) == 0;
+	}
+
+private:
+	struct Tables {
+		Tables() {
+			for(uint32_t i = 0; i < 256; ++i) {
+				uint32_t c = i << 24;
+				for(int k = 0; k < 8; ++k)
+					c = (c & 0x80000000) ? (c << 1) ^ 0x04C11DB7 : c << 1;
+				t_[0][i] = c;
+			}
+			for(int k = 1; k < 8; ++k)
+				for(uint32_t i = 0; i < 256; ++i)
+					t_[k][i] = (t_[k - 1][i] << 8) ^ t_[0][t_[k - 1][i] >> 24];
+		}
+
+		uint32_t t_[8][256];
+	};
+
+	static Tables const& tables() {
+		static const Tables t;
+		return t;
+	}
+};
+
+#endif
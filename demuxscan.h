@@ -0,0 +1,145 @@
+#ifndef _DEMUXSCAN_H_
+#define _DEMUXSCAN_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <linux/dvb/dmx.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "servicescan.h"
+
+// Runs a ServiceScan on a demux device: one section filter per table the
+// scan still needs, all open at the same time.
+
+inline uint64_t now_us() {
+	timeval tv;
+	gettimeofday(&tv, 0);
+	return uint64_t(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+class DemuxFilters {
+public:
+	explicit DemuxFilters(const char* device) : device_(device) {}
+
+	~DemuxFilters() {
+		for(std::map<ScanFilter, int>::iterator i = fds_.begin(); i != fds_.end(); ++i)
+			close(i->second);
+	}
+
+	// Opens the filters not open yet and closes those no longer wanted
+	bool update(std::vector<ScanFilter> const& wanted) {
+		for(std::map<ScanFilter, int>::iterator i = fds_.begin(); i != fds_.end();) {
+			if(std::binary_search(wanted.begin(), wanted.end(), i->first)) {
+				++i;
+				continue;
+			}
+			close(i->second);
+			fds_.erase(i++);
+		}
+
+		for(size_t i = 0; i < wanted.size(); ++i) {
+			if(fds_.count(wanted[i]))
+				continue;
+
+			dmx_sct_filter_params params;
+			memset(&params, 0, sizeof(params));
+			params.pid = wanted[i].pid_;
+			params.filter.filter[0] = wanted[i].table_id_;
+			params.filter.mask[0] = 0xFF;
+			params.flags = DMX_IMMEDIATE_START | DMX_CHECK_CRC;
+
+			int fd = open(device_, O_RDWR | O_NONBLOCK);
+			if(fd < 0) {
+				perror("failed to open demuxer");
+				return false;
+			}
+			if(ioctl(fd, DMX_SET_FILTER, &params) != 0) {
+				fprintf(stderr, "failed to set filter %u:%02x\n", wanted[i].pid_, wanted[i].table_id_);
+				close(fd);
+				return false;
+			}
+			fds_[wanted[i]] = fd;
+		}
+		return true;
+	}
+
+	std::map<ScanFilter, int> const& fds() const { return fds_; }
+
+private:
+	const char* device_;
+	std::map<ScanFilter, int> fds_;
+};
+
+// Feeds the scan until it is complete, 'timeout' microseconds have passed
+// or 'stop' is set; times are wall-clock since the call. Returns non-zero
+// if the device failed.
+inline int scan_demux(const char* device, ServiceScan& scan, uint64_t timeout, volatile sig_atomic_t const& stop) {
+	DemuxFilters filters(device);
+	if(!filters.update(scan.filters()))
+		return 1;
+
+	uint64_t start = now_us();
+	uint8_t buf[4096];
+	std::vector<pollfd> fds;
+	std::vector<uint16_t> pids;
+
+	while(!stop && !scan.complete()) {
+		uint64_t elapsed = now_us() - start;
+		if(elapsed >= timeout)
+			break;
+
+		fds.clear();
+		pids.clear();
+		for(std::map<ScanFilter, int>::const_iterator i = filters.fds().begin(); i != filters.fds().end(); ++i) {
+			pollfd p = {i->second, POLLIN, 0};
+			fds.push_back(p);
+			pids.push_back(i->first.pid_);
+		}
+
+		int r = poll(&fds[0], fds.size(), (timeout - elapsed + 999) / 1000);
+		if(r < 0) {
+			if(errno == EINTR) continue;
+			perror("poll");
+			return 1;
+		}
+
+		bool changed = false;
+		for(size_t i = 0; i < fds.size(); ++i) {
+			if(!(fds[i].revents & (POLLIN | POLLERR)))
+				continue;
+
+			// a section filter returns one section per read
+			for(;;) {
+				int n = read(fds[i].fd, buf, sizeof(buf));
+				if(n < 0) {
+					if(errno == EOVERFLOW)
+						continue;
+					if(errno != EAGAIN && errno != EINTR)
+						perror("read");
+					break;
+				}
+				if(n < 3)
+					break;
+				changed |= scan.add(pids[i], buf, n, now_us() - start);
+			}
+		}
+
+		// closing a filter invalidates the fds of this round, so only now
+		if(changed && !filters.update(scan.filters()))
+			return 1;
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,347 @@
+#ifndef _DESCRIPTORS_H_
+#define _DESCRIPTORS_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "section.h"
+#include "dvbtext.h"
+
+// Descriptor loops stay raw views until they are written out; the
+// registry maps tag and private_data_specifier to the function that writes
+// a descriptor's fields to a record (JsonRecord, BinaryRecord). A tool
+// registers what it prints, every other descriptor is written with its tag
+// only and costs nothing beyond stepping over it.
+//
+// Tags below 0x80 are defined by ISO/IEC 13818-1 and EN 300 468 and mean
+// the same everywhere. Tags from 0x80 up are looked up under the
+// private_data_specifier of the last 0x5f descriptor before them in the
+// same loop, 0 if there is none.
+
+// DVB text of v as UTF-8 in buf, which is reused from call to call
+inline std::string const& text(ByteView v, std::string& buf) {
+	dvb_text_decode(v.data(), v.size(), buf);
+	return buf;
+}
+
+// First descriptor with 'tag' in the loop, for consumers that decode a
+// descriptor only when they need it. 'pds' is the private_data_specifier
+// for tags from 0x80 up.
+inline bool find_descriptor(DescriptorLoop const& loop, uint8_t tag, Descriptor& d, uint32_t pds = 0) {
+	uint32_t current = 0;
+	for(DescriptorLoop::iterator i = loop.begin(); i != loop.end(); ++i) {
+		Descriptor c = *i;
+		if(c.tag() == 0x5f)
+			current = PrivateDataSpecifierDescriptor(c).private_data_specifier();
+		if(c.tag() == tag && (tag < 0x80 || current == pds)) {
+			d = c;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Event text languages to keep, most wanted first. Short (0x4d) and
+// extended (0x4e) event descriptors carry their text once per ISO 639
+// language; only the three bytes of the code are looked at to pick one,
+// the text of the others is never decoded.
+class LanguagePreference {
+public:
+	// "deu,eng", false unless every entry has three characters
+	bool parse(const char* list) {
+		codes_.clear();
+		for(const char* p = list; ; p += 4) {
+			size_t n = strcspn(p, ",");
+			if(n != 3)
+				return false;
+			codes_.push_back(code(reinterpret_cast<const uint8_t*>(p)));
+			if(!p[3])
+				return true;
+		}
+	}
+
+	bool empty() const { return codes_.empty(); }
+
+	// The list in lower case, "" for no preference
+	std::string str() const {
+		std::string s;
+		for(size_t i = 0; i < codes_.size(); ++i) {
+			if(i)
+				s += ',';
+			for(int k = 0; k < 3; ++k)
+				s += char(codes_[i] >> (16 - 8 * k));
+		}
+		return s;
+	}
+
+	// The language of the event descriptors of the loop to keep: the most
+	// wanted one it has, else that of its first event descriptor. False if
+	// it has none.
+	bool choose(DescriptorLoop const& loop, uint32_t& language) const {
+		size_t best = codes_.size();
+		bool found = false;
+		for(DescriptorLoop::iterator i = loop.begin(); i != loop.end() && best; ++i) {
+			uint32_t l = event_language(*i);
+			if(!l)
+				continue;
+			if(!found) {
+				language = l;
+				found = true;
+			}
+			for(size_t k = 0; k < best; ++k) {
+				if(codes_[k] == l) {
+					language = l;
+					best = k;
+					break;
+				}
+			}
+		}
+		return found;
+	}
+
+	// True if the descriptor is not an event descriptor or is one in 'language'
+	static bool keep(Descriptor const& d, uint32_t language) {
+		uint32_t l = event_language(d);
+		return !l || l == language;
+	}
+
+	// Code of a short or extended event descriptor, 0 for any other
+	static uint32_t event_language(Descriptor const& d) {
+		if(d.tag() == 0x4d)
+			return code(d.body().sub(0, 3).data());
+		if(d.tag() == 0x4e)
+			return code(d.body().sub(1, 3).data());
+		return 0;
+	}
+
+private:
+	// the three bytes in lower case, never 0
+	static uint32_t code(const uint8_t* p) {
+		uint32_t c = 1 << 24;
+		for(int i = 0; i < 3; ++i)
+			c |= uint32_t(p[i] >= 'A' && p[i] <= 'Z' ? p[i] | 0x20 : p[i]) << (16 - 8 * i);
+		return c;
+	}
+
+	std::vector<uint32_t> codes_;
+};
+
+// First short_event_descriptor of the loop in the language 'languages'
+// prefers, the first one of all with no preference
+inline bool find_short_event(DescriptorLoop const& loop, LanguagePreference const& languages, Descriptor& d) {
+	uint32_t language = 0;
+	bool filter = !languages.empty() && languages.choose(loop, language);
+	for(DescriptorLoop::iterator i = loop.begin(); i != loop.end(); ++i) {
+		Descriptor c = *i;
+		if(c.tag() == 0x4d && (!filter || LanguagePreference::keep(c, language))) {
+			d = c;
+			return true;
+		}
+	}
+	return false;
+}
+
+template<class Out>
+class DescriptorRegistry {
+public:
+	// Writes the fields after the tag, 'buf' is scratch space for text
+	typedef void (*Writer)(Out& os, Descriptor const& d, std::string& buf);
+
+	DescriptorRegistry() : languages_(0) {
+		for(int i = 0; i < 0x80; ++i)
+			standard_[i] = 0;
+	}
+
+	// Leave out event descriptors in other languages than the one the
+	// preference picks per loop; 'p' must outlive the registry
+	void set_languages(LanguagePreference const* p) {
+		languages_ = p && !p->empty() ? p : 0;
+	}
+
+	// A descriptor defined by ISO/IEC 13818-1 or EN 300 468, tag < 0x80
+	void add(uint8_t tag, Writer w) {
+		if(tag < 0x80)
+			standard_[tag] = w;
+		else
+			add(0, tag, w);
+	}
+
+	// A private descriptor, tag >= 0x80
+	void add(uint32_t pds, uint8_t tag, Writer w) {
+		Private p = {pds, tag, w};
+		private_.push_back(p);
+	}
+
+	Writer find(uint32_t pds, uint8_t tag) const {
+		if(tag < 0x80)
+			return standard_[tag];
+		for(size_t i = 0; i < private_.size(); ++i)
+			if(private_[i].tag_ == tag && private_[i].pds_ == pds)
+				return private_[i].writer_;
+		return 0;
+	}
+
+	// "descriptors":[{"tag":N, ...}, ...]
+	void write(Out& os, DescriptorLoop const& loop, std::string& buf) const {
+		uint32_t language = 0;
+		bool filter = languages_ && languages_->choose(loop, language);
+
+		os.array("descriptors");
+		uint32_t pds = 0;
+		for(DescriptorLoop::iterator i = loop.begin(); i != loop.end(); ++i) {
+			Descriptor d = *i;
+			if(filter && !LanguagePreference::keep(d, language))
+				continue;
+
+			os.object();
+			os.number("tag", d.tag());
+			if(d.tag() == 0x5f) {
+				pds = PrivateDataSpecifierDescriptor(d).private_data_specifier();
+				os.number("private_data_specifier", pds);
+			}
+			else if(Writer w = find(pds, d.tag()))
+				w(os, d, buf);
+			os.end_object();
+		}
+		os.end_array();
+	}
+
+private:
+	struct Private {
+		uint32_t pds_;
+		uint8_t tag_;
+		Writer writer_;
+	};
+
+	Writer standard_[0x80];
+	// few enough for a linear search
+	std::vector<Private> private_;
+	LanguagePreference const* languages_;
+};
+
+/* writers for the descriptors in section.h */
+
+// 0x09
+template<class Out>
+void write_ca_descriptor(Out& os, Descriptor const& d, std::string&) {
+	CaDescriptor ca(d);
+	os.number("CA_system_id", ca.ca_system_id());
+	os.number("CA_PID", ca.ca_pid());
+}
+
+// 0x43, frequency, orbital_position, symbol_rate and FEC_inner are printed in hex, which reads as their BCD digits
+template<class Out>
+void write_satellite_delivery_descriptor(Out& os, Descriptor const& d, std::string&) {
+	SatelliteDeliveryDescriptor sd(d);
+	os.hex("frequency", sd.frequency());
+	os.hex("orbital_position", sd.orbital_position());
+	os.number("west_east_flag", sd.west_east_flag());
+	os.number("polarization", sd.polarization());
+	os.number("modulation", sd.modulation());
+	os.hex("symbol_rate", sd.symbol_rate());
+	os.hex("FEC_inner", sd.fec_inner());
+}
+
+// 0x48, names escaped the way parse-sdt has always printed them
+template<class Out>
+void write_service_descriptor(Out& os, Descriptor const& d, std::string& buf) {
+	ServiceDescriptor sd(d);
+	os.number("type", sd.service_type());
+	os.text("provider", text(sd.provider_name(), buf), false);
+	os.text("name", text(sd.service_name(), buf), false);
+}
+
+// 0x4d
+template<class Out>
+void write_short_event_descriptor(Out& os, Descriptor const& d, std::string& buf) {
+	ShortEventDescriptor se(d);
+	os.code("ISO_639_language_code", se.language());
+	os.text("name", text(se.event_name(), buf));
+	os.text("text", text(se.text(), buf));
+}
+
+// 0x4e
+template<class Out>
+void write_extended_event_descriptor(Out& os, Descriptor const& d, std::string& buf) {
+	ExtendedEventDescriptor ee(d);
+	os.number("descriptor_number", ee.descriptor_number());
+	os.number("last_descriptor_number", ee.last_descriptor_number());
+	os.code("ISO_639_language_code", ee.language());
+
+	os.array("items");
+	Loop<ExtendedEventItem> items = ee.items();
+	for(Loop<ExtendedEventItem>::iterator i = items.begin(); i != items.end(); ++i) {
+		ExtendedEventItem item = *i;
+		os.object();
+		os.text("description", text(item.description(), buf));
+		os.text("item", text(item.item(), buf));
+		os.end_object();
+	}
+	os.end_array();
+
+	os.text("text", text(ee.text(), buf));
+}
+
+// 0x50
+template<class Out>
+void write_component_descriptor(Out& os, Descriptor const& d, std::string& buf) {
+	ComponentDescriptor c(d);
+	os.number("stream_content_ext", c.stream_content_ext());
+	os.number("stream_content", c.stream_content());
+	os.number("component_type", c.component_type());
+	os.number("component_tag", c.component_tag());
+	os.code("ISO_639_language_code", c.language());
+	os.text("text", text(c.text(), buf));
+}
+
+// 0x54
+template<class Out>
+void write_content_descriptor(Out& os, Descriptor const& d, std::string&) {
+	os.array("items");
+	Loop<ContentItem> items = ContentDescriptor(d).items();
+	for(Loop<ContentItem>::iterator i = items.begin(); i != items.end(); ++i) {
+		ContentItem item = *i;
+		os.object();
+		os.number("content_nibble_level_1", item.level_1());
+		os.number("content_nibble_level_2", item.level_2());
+		os.number("user_byte", item.user_byte());
+		os.end_object();
+	}
+	os.end_array();
+}
+
+// 0x5a
+template<class Out>
+void write_terrestrial_delivery_descriptor(Out& os, Descriptor const& d, std::string&) {
+	TerrestrialDeliveryDescriptor td(d);
+	os.number("centre_frequency", td.centre_frequency());
+	os.number("bandwith", td.bandwidth());
+	os.number("constelation", td.constellation());
+	os.number("hierarchy_information", td.hierarchy_information());
+	os.number("code_rate-HP_stream", td.code_rate_hp());
+	os.number("code_rate-LP_stream", td.code_rate_lp());
+	os.number("guard_interval", td.guard_interval());
+	os.number("transmission_mode", td.transmission_mode());
+	os.number("other_frequency_frequency_flag", td.other_frequency_flag());
+}
+
+// 0x83 under private_data_specifier 0x28 (EACEM)
+template<class Out>
+void write_logical_channel_descriptor(Out& os, Descriptor const& d, std::string&) {
+	os.array("channels");
+	Loop<LogicalChannel> channels = LogicalChannelDescriptor(d).channels();
+	for(Loop<LogicalChannel>::iterator i = channels.begin(); i != channels.end(); ++i) {
+		LogicalChannel c = *i;
+		os.object();
+		os.number("service_id", c.service_id());
+		os.flag("visible_service_flag", c.visible_service_flag());
+		os.number("logical_channel_number", c.logical_channel_number());
+		os.end_object();
+	}
+	os.end_array();
+}
+
+#endif
@@ -0,0 +1,439 @@
+#include <string.h>
+
+#include <algorithm>
+
+#include "dvbtext.h"
+
+namespace {
+
+struct Composed {
+	uint8_t mark_;
+	char base_;
+	uint16_t code_;
+};
+
+// Upper half of character table 00 (figure A.1): ISO 6937 with the euro
+// sign at 0xA4. 0xC1..0xCF are non-spacing diacritics written before the
+// letter, listed here in their spacing form for when no letter follows.
+const uint16_t latin00[96] = {
+	0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x20AC, 0x00A5, 0x0023, 0x00A7, 0x00A4, 0x2018, 0x201C, 0x00AB,
+	0x2190, 0x2191, 0x2192, 0x2193, 0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00D7, 0x00B5, 0x00B6, 0x00B7,
+	0x00F7, 0x2019, 0x201D, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF, 0x0000, 0x0060, 0x00B4, 0x02C6,
+	0x02DC, 0x00AF, 0x02D8, 0x02D9, 0x00A8, 0x0000, 0x02DA, 0x00B8, 0x0000, 0x02DD, 0x02DB, 0x02C7,
+	0x2015, 0x00B9, 0x00AE, 0x00A9, 0x2122, 0x266A, 0x00AC, 0x00A6, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x215B, 0x215C, 0x215D, 0x215E, 0x2126, 0x00C6, 0x0110, 0x00AA, 0x0126, 0x0000, 0x0132, 0x013F,
+	0x0141, 0x00D8, 0x0152, 0x00BA, 0x00DE, 0x0166, 0x014A, 0x0149, 0x0138, 0x00E6, 0x0111, 0x00F0,
+	0x0127, 0x0131, 0x0133, 0x0140, 0x0142, 0x00F8, 0x0153, 0x00DF, 0x00FE, 0x0167, 0x014B, 0x00AD,
+};
+
+// Combining characters for the diacritics 0xC0..0xCF of table 00
+const uint16_t marks[16] = {
+	0x0000, 0x0300, 0x0301, 0x0302, 0x0303, 0x0304, 0x0306, 0x0307,
+	0x0308, 0x0000, 0x030A, 0x0327, 0x0000, 0x030B, 0x0328, 0x030C,
+};
+
+// Upper halves (0xA0..0xFF) of ISO/IEC 8859-1..15, 0 where a part has no character
+const uint16_t iso8859[16][96] = {
+	{0}, // unused
+	{ // 8859-1
+		0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7, 0x00A8, 0x00A9, 0x00AA, 0x00AB,
+		0x00AC, 0x00AD, 0x00AE, 0x00AF, 0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+		0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF, 0x00C0, 0x00C1, 0x00C2, 0x00C3,
+		0x00C4, 0x00C5, 0x00C6, 0x00C7, 0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+		0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7, 0x00D8, 0x00D9, 0x00DA, 0x00DB,
+		0x00DC, 0x00DD, 0x00DE, 0x00DF, 0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+		0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF, 0x00F0, 0x00F1, 0x00F2, 0x00F3,
+		0x00F4, 0x00F5, 0x00F6, 0x00F7, 0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF,
+	},
+	{ // 8859-2
+		0x00A0, 0x0104, 0x02D8, 0x0141, 0x00A4, 0x013D, 0x015A, 0x00A7, 0x00A8, 0x0160, 0x015E, 0x0164,
+		0x0179, 0x00AD, 0x017D, 0x017B, 0x00B0, 0x0105, 0x02DB, 0x0142, 0x00B4, 0x013E, 0x015B, 0x02C7,
+		0x00B8, 0x0161, 0x015F, 0x0165, 0x017A, 0x02DD, 0x017E, 0x017C, 0x0154, 0x00C1, 0x00C2, 0x0102,
+		0x00C4, 0x0139, 0x0106, 0x00C7, 0x010C, 0x00C9, 0x0118, 0x00CB, 0x011A, 0x00CD, 0x00CE, 0x010E,
+		0x0110, 0x0143, 0x0147, 0x00D3, 0x00D4, 0x0150, 0x00D6, 0x00D7, 0x0158, 0x016E, 0x00DA, 0x0170,
+		0x00DC, 0x00DD, 0x0162, 0x00DF, 0x0155, 0x00E1, 0x00E2, 0x0103, 0x00E4, 0x013A, 0x0107, 0x00E7,
+		0x010D, 0x00E9, 0x0119, 0x00EB, 0x011B, 0x00ED, 0x00EE, 0x010F, 0x0111, 0x0144, 0x0148, 0x00F3,
+		0x00F4, 0x0151, 0x00F6, 0x00F7, 0x0159, 0x016F, 0x00FA, 0x0171, 0x00FC, 0x00FD, 0x0163, 0x02D9,
+	},
+	{ // 8859-3
+		0x00A0, 0x0126, 0x02D8, 0x00A3, 0x00A4, 0x0000, 0x0124, 0x00A7, 0x00A8, 0x0130, 0x015E, 0x011E,
+		0x0134, 0x00AD, 0x0000, 0x017B, 0x00B0, 0x0127, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x0125, 0x00B7,
+		0x00B8, 0x0131, 0x015F, 0x011F, 0x0135, 0x00BD, 0x0000, 0x017C, 0x00C0, 0x00C1, 0x00C2, 0x0000,
+		0x00C4, 0x010A, 0x0108, 0x00C7, 0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+		0x0000, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x0120, 0x00D6, 0x00D7, 0x011C, 0x00D9, 0x00DA, 0x00DB,
+		0x00DC, 0x016C, 0x015C, 0x00DF, 0x00E0, 0x00E1, 0x00E2, 0x0000, 0x00E4, 0x010B, 0x0109, 0x00E7,
+		0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF, 0x0000, 0x00F1, 0x00F2, 0x00F3,
+		0x00F4, 0x0121, 0x00F6, 0x00F7, 0x011D, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x016D, 0x015D, 0x02D9,
+	},
+	{ // 8859-4
+		0x00A0, 0x0104, 0x0138, 0x0156, 0x00A4, 0x0128, 0x013B, 0x00A7, 0x00A8, 0x0160, 0x0112, 0x0122,
+		0x0166, 0x00AD, 0x017D, 0x00AF, 0x00B0, 0x0105, 0x02DB, 0x0157, 0x00B4, 0x0129, 0x013C, 0x02C7,
+		0x00B8, 0x0161, 0x0113, 0x0123, 0x0167, 0x014A, 0x017E, 0x014B, 0x0100, 0x00C1, 0x00C2, 0x00C3,
+		0x00C4, 0x00C5, 0x00C6, 0x012E, 0x010C, 0x00C9, 0x0118, 0x00CB, 0x0116, 0x00CD, 0x00CE, 0x012A,
+		0x0110, 0x0145, 0x014C, 0x0136, 0x00D4, 0x00D5, 0x00D6, 0x00D7, 0x00D8, 0x0172, 0x00DA, 0x00DB,
+		0x00DC, 0x0168, 0x016A, 0x00DF, 0x0101, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x012F,
+		0x010D, 0x00E9, 0x0119, 0x00EB, 0x0117, 0x00ED, 0x00EE, 0x012B, 0x0111, 0x0146, 0x014D, 0x0137,
+		0x00F4, 0x00F5, 0x00F6, 0x00F7, 0x00F8, 0x0173, 0x00FA, 0x00FB, 0x00FC, 0x0169, 0x016B, 0x02D9,
+	},
+	{ // 8859-5
+		0x00A0, 0x0401, 0x0402, 0x0403, 0x0404, 0x0405, 0x0406, 0x0407, 0x0408, 0x0409, 0x040A, 0x040B,
+		0x040C, 0x00AD, 0x040E, 0x040F, 0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,
+		0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E, 0x041F, 0x0420, 0x0421, 0x0422, 0x0423,
+		0x0424, 0x0425, 0x0426, 0x0427, 0x0428, 0x0429, 0x042A, 0x042B, 0x042C, 0x042D, 0x042E, 0x042F,
+		0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437, 0x0438, 0x0439, 0x043A, 0x043B,
+		0x043C, 0x043D, 0x043E, 0x043F, 0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+		0x0448, 0x0449, 0x044A, 0x044B, 0x044C, 0x044D, 0x044E, 0x044F, 0x2116, 0x0451, 0x0452, 0x0453,
+		0x0454, 0x0455, 0x0456, 0x0457, 0x0458, 0x0459, 0x045A, 0x045B, 0x045C, 0x00A7, 0x045E, 0x045F,
+	},
+	{ // 8859-6
+		0x00A0, 0x0000, 0x0000, 0x0000, 0x00A4, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x060C, 0x00AD, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x061B, 0x0000, 0x0000, 0x0000, 0x061F, 0x0000, 0x0621, 0x0622, 0x0623,
+		0x0624, 0x0625, 0x0626, 0x0627, 0x0628, 0x0629, 0x062A, 0x062B, 0x062C, 0x062D, 0x062E, 0x062F,
+		0x0630, 0x0631, 0x0632, 0x0633, 0x0634, 0x0635, 0x0636, 0x0637, 0x0638, 0x0639, 0x063A, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x0640, 0x0641, 0x0642, 0x0643, 0x0644, 0x0645, 0x0646, 0x0647,
+		0x0648, 0x0649, 0x064A, 0x064B, 0x064C, 0x064D, 0x064E, 0x064F, 0x0650, 0x0651, 0x0652, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	},
+	{ // 8859-7
+		0x00A0, 0x2018, 0x2019, 0x00A3, 0x20AC, 0x20AF, 0x00A6, 0x00A7, 0x00A8, 0x00A9, 0x037A, 0x00AB,
+		0x00AC, 0x00AD, 0x0000, 0x2015, 0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x0384, 0x0385, 0x0386, 0x00B7,
+		0x0388, 0x0389, 0x038A, 0x00BB, 0x038C, 0x00BD, 0x038E, 0x038F, 0x0390, 0x0391, 0x0392, 0x0393,
+		0x0394, 0x0395, 0x0396, 0x0397, 0x0398, 0x0399, 0x039A, 0x039B, 0x039C, 0x039D, 0x039E, 0x039F,
+		0x03A0, 0x03A1, 0x0000, 0x03A3, 0x03A4, 0x03A5, 0x03A6, 0x03A7, 0x03A8, 0x03A9, 0x03AA, 0x03AB,
+		0x03AC, 0x03AD, 0x03AE, 0x03AF, 0x03B0, 0x03B1, 0x03B2, 0x03B3, 0x03B4, 0x03B5, 0x03B6, 0x03B7,
+		0x03B8, 0x03B9, 0x03BA, 0x03BB, 0x03BC, 0x03BD, 0x03BE, 0x03BF, 0x03C0, 0x03C1, 0x03C2, 0x03C3,
+		0x03C4, 0x03C5, 0x03C6, 0x03C7, 0x03C8, 0x03C9, 0x03CA, 0x03CB, 0x03CC, 0x03CD, 0x03CE, 0x0000,
+	},
+	{ // 8859-8
+		0x00A0, 0x0000, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7, 0x00A8, 0x00A9, 0x00D7, 0x00AB,
+		0x00AC, 0x00AD, 0x00AE, 0x00AF, 0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+		0x00B8, 0x00B9, 0x00F7, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x2017, 0x05D0, 0x05D1, 0x05D2, 0x05D3, 0x05D4, 0x05D5, 0x05D6, 0x05D7,
+		0x05D8, 0x05D9, 0x05DA, 0x05DB, 0x05DC, 0x05DD, 0x05DE, 0x05DF, 0x05E0, 0x05E1, 0x05E2, 0x05E3,
+		0x05E4, 0x05E5, 0x05E6, 0x05E7, 0x05E8, 0x05E9, 0x05EA, 0x0000, 0x0000, 0x200E, 0x200F, 0x0000,
+	},
+	{ // 8859-9
+		0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7, 0x00A8, 0x00A9, 0x00AA, 0x00AB,
+		0x00AC, 0x00AD, 0x00AE, 0x00AF, 0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+		0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF, 0x00C0, 0x00C1, 0x00C2, 0x00C3,
+		0x00C4, 0x00C5, 0x00C6, 0x00C7, 0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+		0x011E, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7, 0x00D8, 0x00D9, 0x00DA, 0x00DB,
+		0x00DC, 0x0130, 0x015E, 0x00DF, 0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+		0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF, 0x011F, 0x00F1, 0x00F2, 0x00F3,
+		0x00F4, 0x00F5, 0x00F6, 0x00F7, 0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x0131, 0x015F, 0x00FF,
+	},
+	{ // 8859-10
+		0x00A0, 0x0104, 0x0112, 0x0122, 0x012A, 0x0128, 0x0136, 0x00A7, 0x013B, 0x0110, 0x0160, 0x0166,
+		0x017D, 0x00AD, 0x016A, 0x014A, 0x00B0, 0x0105, 0x0113, 0x0123, 0x012B, 0x0129, 0x0137, 0x00B7,
+		0x013C, 0x0111, 0x0161, 0x0167, 0x017E, 0x2015, 0x016B, 0x014B, 0x0100, 0x00C1, 0x00C2, 0x00C3,
+		0x00C4, 0x00C5, 0x00C6, 0x012E, 0x010C, 0x00C9, 0x0118, 0x00CB, 0x0116, 0x00CD, 0x00CE, 0x00CF,
+		0x00D0, 0x0145, 0x014C, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x0168, 0x00D8, 0x0172, 0x00DA, 0x00DB,
+		0x00DC, 0x00DD, 0x00DE, 0x00DF, 0x0101, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x012F,
+		0x010D, 0x00E9, 0x0119, 0x00EB, 0x0117, 0x00ED, 0x00EE, 0x00EF, 0x00F0, 0x0146, 0x014D, 0x00F3,
+		0x00F4, 0x00F5, 0x00F6, 0x0169, 0x00F8, 0x0173, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x0138,
+	},
+	{ // 8859-11
+		0x00A0, 0x0E01, 0x0E02, 0x0E03, 0x0E04, 0x0E05, 0x0E06, 0x0E07, 0x0E08, 0x0E09, 0x0E0A, 0x0E0B,
+		0x0E0C, 0x0E0D, 0x0E0E, 0x0E0F, 0x0E10, 0x0E11, 0x0E12, 0x0E13, 0x0E14, 0x0E15, 0x0E16, 0x0E17,
+		0x0E18, 0x0E19, 0x0E1A, 0x0E1B, 0x0E1C, 0x0E1D, 0x0E1E, 0x0E1F, 0x0E20, 0x0E21, 0x0E22, 0x0E23,
+		0x0E24, 0x0E25, 0x0E26, 0x0E27, 0x0E28, 0x0E29, 0x0E2A, 0x0E2B, 0x0E2C, 0x0E2D, 0x0E2E, 0x0E2F,
+		0x0E30, 0x0E31, 0x0E32, 0x0E33, 0x0E34, 0x0E35, 0x0E36, 0x0E37, 0x0E38, 0x0E39, 0x0E3A, 0x0000,
+		0x0000, 0x0000, 0x0000, 0x0E3F, 0x0E40, 0x0E41, 0x0E42, 0x0E43, 0x0E44, 0x0E45, 0x0E46, 0x0E47,
+		0x0E48, 0x0E49, 0x0E4A, 0x0E4B, 0x0E4C, 0x0E4D, 0x0E4E, 0x0E4F, 0x0E50, 0x0E51, 0x0E52, 0x0E53,
+		0x0E54, 0x0E55, 0x0E56, 0x0E57, 0x0E58, 0x0E59, 0x0E5A, 0x0E5B, 0x0000, 0x0000, 0x0000, 0x0000,
+	},
+	{0}, // 8859-12 does not exist
+	{ // 8859-13
+		0x00A0, 0x201D, 0x00A2, 0x00A3, 0x00A4, 0x201E, 0x00A6, 0x00A7, 0x00D8, 0x00A9, 0x0156, 0x00AB,
+		0x00AC, 0x00AD, 0x00AE, 0x00C6, 0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x201C, 0x00B5, 0x00B6, 0x00B7,
+		0x00F8, 0x00B9, 0x0157, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00E6, 0x0104, 0x012E, 0x0100, 0x0106,
+		0x00C4, 0x00C5, 0x0118, 0x0112, 0x010C, 0x00C9, 0x0179, 0x0116, 0x0122, 0x0136, 0x012A, 0x013B,
+		0x0160, 0x0143, 0x0145, 0x00D3, 0x014C, 0x00D5, 0x00D6, 0x00D7, 0x0172, 0x0141, 0x015A, 0x016A,
+		0x00DC, 0x017B, 0x017D, 0x00DF, 0x0105, 0x012F, 0x0101, 0x0107, 0x00E4, 0x00E5, 0x0119, 0x0113,
+		0x010D, 0x00E9, 0x017A, 0x0117, 0x0123, 0x0137, 0x012B, 0x013C, 0x0161, 0x0144, 0x0146, 0x00F3,
+		0x014D, 0x00F5, 0x00F6, 0x00F7, 0x0173, 0x0142, 0x015B, 0x016B, 0x00FC, 0x017C, 0x017E, 0x2019,
+	},
+	{ // 8859-14
+		0x00A0, 0x1E02, 0x1E03, 0x00A3, 0x010A, 0x010B, 0x1E0A, 0x00A7, 0x1E80, 0x00A9, 0x1E82, 0x1E0B,
+		0x1EF2, 0x00AD, 0x00AE, 0x0178, 0x1E1E, 0x1E1F, 0x0120, 0x0121, 0x1E40, 0x1E41, 0x00B6, 0x1E56,
+		0x1E81, 0x1E57, 0x1E83, 0x1E60, 0x1EF3, 0x1E84, 0x1E85, 0x1E61, 0x00C0, 0x00C1, 0x00C2, 0x00C3,
+		0x00C4, 0x00C5, 0x00C6, 0x00C7, 0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+		0x0174, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x1E6A, 0x00D8, 0x00D9, 0x00DA, 0x00DB,
+		0x00DC, 0x00DD, 0x0176, 0x00DF, 0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+		0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF, 0x0175, 0x00F1, 0x00F2, 0x00F3,
+		0x00F4, 0x00F5, 0x00F6, 0x1E6B, 0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x0177, 0x00FF,
+	},
+	{ // 8859-15
+		0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x20AC, 0x00A5, 0x0160, 0x00A7, 0x0161, 0x00A9, 0x00AA, 0x00AB,
+		0x00AC, 0x00AD, 0x00AE, 0x00AF, 0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x017D, 0x00B5, 0x00B6, 0x00B7,
+		0x017E, 0x00B9, 0x00BA, 0x00BB, 0x0152, 0x0153, 0x0178, 0x00BF, 0x00C0, 0x00C1, 0x00C2, 0x00C3,
+		0x00C4, 0x00C5, 0x00C6, 0x00C7, 0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+		0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7, 0x00D8, 0x00D9, 0x00DA, 0x00DB,
+		0x00DC, 0x00DD, 0x00DE, 0x00DF, 0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+		0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF, 0x00F0, 0x00F1, 0x00F2, 0x00F3,
+		0x00F4, 0x00F5, 0x00F6, 0x00F7, 0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF,
+	},
+};
+
+// Letters that ISO 6937 writes as non-spacing diacritic + base and Unicode has precomposed
+const Composed composed[] = {
+	{0xC1, 'A', 0x00C0}, {0xC1, 'E', 0x00C8}, {0xC1, 'I', 0x00CC}, {0xC1, 'N', 0x01F8}, {0xC1, 'O', 0x00D2}, {0xC1, 'U', 0x00D9},
+	{0xC1, 'W', 0x1E80}, {0xC1, 'Y', 0x1EF2}, {0xC1, 'a', 0x00E0}, {0xC1, 'e', 0x00E8}, {0xC1, 'i', 0x00EC}, {0xC1, 'n', 0x01F9},
+	{0xC1, 'o', 0x00F2}, {0xC1, 'u', 0x00F9}, {0xC1, 'w', 0x1E81}, {0xC1, 'y', 0x1EF3},
+	{0xC2, 'A', 0x00C1}, {0xC2, 'C', 0x0106}, {0xC2, 'E', 0x00C9}, {0xC2, 'G', 0x01F4}, {0xC2, 'I', 0x00CD}, {0xC2, 'K', 0x1E30},
+	{0xC2, 'L', 0x0139}, {0xC2, 'M', 0x1E3E}, {0xC2, 'N', 0x0143}, {0xC2, 'O', 0x00D3}, {0xC2, 'P', 0x1E54}, {0xC2, 'R', 0x0154},
+	{0xC2, 'S', 0x015A}, {0xC2, 'U', 0x00DA}, {0xC2, 'W', 0x1E82}, {0xC2, 'Y', 0x00DD}, {0xC2, 'Z', 0x0179}, {0xC2, 'a', 0x00E1},
+	{0xC2, 'c', 0x0107}, {0xC2, 'e', 0x00E9}, {0xC2, 'g', 0x01F5}, {0xC2, 'i', 0x00ED}, {0xC2, 'k', 0x1E31}, {0xC2, 'l', 0x013A},
+	{0xC2, 'm', 0x1E3F}, {0xC2, 'n', 0x0144}, {0xC2, 'o', 0x00F3}, {0xC2, 'p', 0x1E55}, {0xC2, 'r', 0x0155}, {0xC2, 's', 0x015B},
+	{0xC2, 'u', 0x00FA}, {0xC2, 'w', 0x1E83}, {0xC2, 'y', 0x00FD}, {0xC2, 'z', 0x017A},
+	{0xC3, 'A', 0x00C2}, {0xC3, 'C', 0x0108}, {0xC3, 'E', 0x00CA}, {0xC3, 'G', 0x011C}, {0xC3, 'H', 0x0124}, {0xC3, 'I', 0x00CE},
+	{0xC3, 'J', 0x0134}, {0xC3, 'O', 0x00D4}, {0xC3, 'S', 0x015C}, {0xC3, 'U', 0x00DB}, {0xC3, 'W', 0x0174}, {0xC3, 'Y', 0x0176},
+	{0xC3, 'Z', 0x1E90}, {0xC3, 'a', 0x00E2}, {0xC3, 'c', 0x0109}, {0xC3, 'e', 0x00EA}, {0xC3, 'g', 0x011D}, {0xC3, 'h', 0x0125},
+	{0xC3, 'i', 0x00EE}, {0xC3, 'j', 0x0135}, {0xC3, 'o', 0x00F4}, {0xC3, 's', 0x015D}, {0xC3, 'u', 0x00FB}, {0xC3, 'w', 0x0175},
+	{0xC3, 'y', 0x0177}, {0xC3, 'z', 0x1E91},
+	{0xC4, 'A', 0x00C3}, {0xC4, 'E', 0x1EBC}, {0xC4, 'I', 0x0128}, {0xC4, 'N', 0x00D1}, {0xC4, 'O', 0x00D5}, {0xC4, 'U', 0x0168},
+	{0xC4, 'V', 0x1E7C}, {0xC4, 'Y', 0x1EF8}, {0xC4, 'a', 0x00E3}, {0xC4, 'e', 0x1EBD}, {0xC4, 'i', 0x0129}, {0xC4, 'n', 0x00F1},
+	{0xC4, 'o', 0x00F5}, {0xC4, 'u', 0x0169}, {0xC4, 'v', 0x1E7D}, {0xC4, 'y', 0x1EF9},
+	{0xC5, 'A', 0x0100}, {0xC5, 'E', 0x0112}, {0xC5, 'G', 0x1E20}, {0xC5, 'I', 0x012A}, {0xC5, 'O', 0x014C}, {0xC5, 'U', 0x016A},
+	{0xC5, 'Y', 0x0232}, {0xC5, 'a', 0x0101}, {0xC5, 'e', 0x0113}, {0xC5, 'g', 0x1E21}, {0xC5, 'i', 0x012B}, {0xC5, 'o', 0x014D},
+	{0xC5, 'u', 0x016B}, {0xC5, 'y', 0x0233},
+	{0xC6, 'A', 0x0102}, {0xC6, 'E', 0x0114}, {0xC6, 'G', 0x011E}, {0xC6, 'I', 0x012C}, {0xC6, 'O', 0x014E}, {0xC6, 'U', 0x016C},
+	{0xC6, 'a', 0x0103}, {0xC6, 'e', 0x0115}, {0xC6, 'g', 0x011F}, {0xC6, 'i', 0x012D}, {0xC6, 'o', 0x014F}, {0xC6, 'u', 0x016D},
+	{0xC7, 'A', 0x0226}, {0xC7, 'B', 0x1E02}, {0xC7, 'C', 0x010A}, {0xC7, 'D', 0x1E0A}, {0xC7, 'E', 0x0116}, {0xC7, 'F', 0x1E1E},
+	{0xC7, 'G', 0x0120}, {0xC7, 'H', 0x1E22}, {0xC7, 'I', 0x0130}, {0xC7, 'M', 0x1E40}, {0xC7, 'N', 0x1E44}, {0xC7, 'O', 0x022E},
+	{0xC7, 'P', 0x1E56}, {0xC7, 'R', 0x1E58}, {0xC7, 'S', 0x1E60}, {0xC7, 'T', 0x1E6A}, {0xC7, 'W', 0x1E86}, {0xC7, 'X', 0x1E8A},
+	{0xC7, 'Y', 0x1E8E}, {0xC7, 'Z', 0x017B}, {0xC7, 'a', 0x0227}, {0xC7, 'b', 0x1E03}, {0xC7, 'c', 0x010B}, {0xC7, 'd', 0x1E0B},
+	{0xC7, 'e', 0x0117}, {0xC7, 'f', 0x1E1F}, {0xC7, 'g', 0x0121}, {0xC7, 'h', 0x1E23}, {0xC7, 'm', 0x1E41}, {0xC7, 'n', 0x1E45},
+	{0xC7, 'o', 0x022F}, {0xC7, 'p', 0x1E57}, {0xC7, 'r', 0x1E59}, {0xC7, 's', 0x1E61}, {0xC7, 't', 0x1E6B}, {0xC7, 'w', 0x1E87},
+	{0xC7, 'x', 0x1E8B}, {0xC7, 'y', 0x1E8F}, {0xC7, 'z', 0x017C},
+	{0xC8, 'A', 0x00C4}, {0xC8, 'E', 0x00CB}, {0xC8, 'H', 0x1E26}, {0xC8, 'I', 0x00CF}, {0xC8, 'O', 0x00D6}, {0xC8, 'U', 0x00DC},
+	{0xC8, 'W', 0x1E84}, {0xC8, 'X', 0x1E8C}, {0xC8, 'Y', 0x0178}, {0xC8, 'a', 0x00E4}, {0xC8, 'e', 0x00EB}, {0xC8, 'h', 0x1E27},
+	{0xC8, 'i', 0x00EF}, {0xC8, 'o', 0x00F6}, {0xC8, 't', 0x1E97}, {0xC8, 'u', 0x00FC}, {0xC8, 'w', 0x1E85}, {0xC8, 'x', 0x1E8D},
+	{0xC8, 'y', 0x00FF},
+	{0xCA, 'A', 0x00C5}, {0xCA, 'U', 0x016E}, {0xCA, 'a', 0x00E5}, {0xCA, 'u', 0x016F}, {0xCA, 'w', 0x1E98}, {0xCA, 'y', 0x1E99},
+	{0xCB, 'C', 0x00C7}, {0xCB, 'D', 0x1E10}, {0xCB, 'E', 0x0228}, {0xCB, 'G', 0x0122}, {0xCB, 'H', 0x1E28}, {0xCB, 'K', 0x0136},
+	{0xCB, 'L', 0x013B}, {0xCB, 'N', 0x0145}, {0xCB, 'R', 0x0156}, {0xCB, 'S', 0x015E}, {0xCB, 'T', 0x0162}, {0xCB, 'c', 0x00E7},
+	{0xCB, 'd', 0x1E11}, {0xCB, 'e', 0x0229}, {0xCB, 'g', 0x0123}, {0xCB, 'h', 0x1E29}, {0xCB, 'k', 0x0137}, {0xCB, 'l', 0x013C},
+	{0xCB, 'n', 0x0146}, {0xCB, 'r', 0x0157}, {0xCB, 's', 0x015F}, {0xCB, 't', 0x0163},
+	{0xCD, 'O', 0x0150}, {0xCD, 'U', 0x0170}, {0xCD, 'o', 0x0151}, {0xCD, 'u', 0x0171},
+	{0xCE, 'A', 0x0104}, {0xCE, 'E', 0x0118}, {0xCE, 'I', 0x012E}, {0xCE, 'O', 0x01EA}, {0xCE, 'U', 0x0172}, {0xCE, 'a', 0x0105},
+	{0xCE, 'e', 0x0119}, {0xCE, 'i', 0x012F}, {0xCE, 'o', 0x01EB}, {0xCE, 'u', 0x0173},
+	{0xCF, 'A', 0x01CD}, {0xCF, 'C', 0x010C}, {0xCF, 'D', 0x010E}, {0xCF, 'E', 0x011A}, {0xCF, 'G', 0x01E6}, {0xCF, 'H', 0x021E},
+	{0xCF, 'I', 0x01CF}, {0xCF, 'K', 0x01E8}, {0xCF, 'L', 0x013D}, {0xCF, 'N', 0x0147}, {0xCF, 'O', 0x01D1}, {0xCF, 'R', 0x0158},
+	{0xCF, 'S', 0x0160}, {0xCF, 'T', 0x0164}, {0xCF, 'U', 0x01D3}, {0xCF, 'Z', 0x017D}, {0xCF, 'a', 0x01CE}, {0xCF, 'c', 0x010D},
+	{0xCF, 'd', 0x010F}, {0xCF, 'e', 0x011B}, {0xCF, 'g', 0x01E7}, {0xCF, 'h', 0x021F}, {0xCF, 'i', 0x01D0}, {0xCF, 'j', 0x01F0},
+	{0xCF, 'k', 0x01E9}, {0xCF, 'l', 0x013E}, {0xCF, 'n', 0x0148}, {0xCF, 'o', 0x01D2}, {0xCF, 'r', 0x0159}, {0xCF, 's', 0x0161},
+	{0xCF, 't', 0x0165}, {0xCF, 'u', 0x01D4}, {0xCF, 'z', 0x017E},
+};
+
+struct Utf8 {
+	uint8_t len_;
+	char s_[3];
+};
+
+size_t put_utf8(uint32_t c, char* o) {
+	if(c < 0x80) {
+		o[0] = c;
+		return 1;
+	}
+	if(c < 0x800) {
+		o[0] = 0xC0 | (c >> 6);
+		o[1] = 0x80 | (c & 0x3F);
+		return 2;
+	}
+	if(c < 0x10000) {
+		o[0] = 0xE0 | (c >> 12);
+		o[1] = 0x80 | ((c >> 6) & 0x3F);
+		o[2] = 0x80 | (c & 0x3F);
+		return 3;
+	}
+	o[0] = 0xF0 | (c >> 18);
+	o[1] = 0x80 | ((c >> 12) & 0x3F);
+	o[2] = 0x80 | ((c >> 6) & 0x3F);
+	o[3] = 0x80 | (c & 0x3F);
+	return 4;
+}
+
+Utf8 utf8(uint32_t c) {
+	Utf8 u = {0, {0}};
+	if(c)
+		u.len_ = put_utf8(c, u.s_);
+	return u;
+}
+
+// UTF-8 for every byte of every single byte table, built once
+struct Tables {
+	Tables() {
+		for(int t = 0; t < 16; ++t) {
+			for(int c = 0; c < 0x80; ++c)
+				byte_[t][c] = utf8(c);
+			for(int c = 0x80; c < 0xA0; ++c)
+				byte_[t][c] = utf8(0);
+			byte_[t][0x8A] = utf8('\n');
+			for(int c = 0xA0; c < 0x100; ++c)
+				byte_[t][c] = utf8(t ? iso8859[t][c - 0xA0] : latin00[c - 0xA0]);
+		}
+
+		memset(composed_, 0, sizeof(composed_));
+		for(size_t i = 0; i < sizeof(composed) / sizeof(composed[0]); ++i)
+			composed_[composed[i].mark_ & 0x0F][(uint8_t)composed[i].base_] = utf8(composed[i].code_);
+		for(int m = 0; m < 16; ++m)
+			mark_[m] = utf8(marks[m]);
+	}
+
+	Utf8 byte_[16][256];      // [0] is table 00, [n] ISO 8859-n
+	Utf8 composed_[16][128];  // diacritic 0xC0 + index, ASCII letter
+	Utf8 mark_[16];
+};
+
+Tables const& tables() {
+	static const Tables t;
+	return t;
+}
+
+inline bool ascii8(const uint8_t* s) {
+	uint64_t w;
+	memcpy(&w, s, 8);
+	return !(w & 0x8080808080808080ull);
+}
+
+inline char* put(Utf8 const& u, char* o) {
+	memcpy(o, u.s_, 3);
+	return o + u.len_;
+}
+
+char* single(Tables const& t, int table, const uint8_t* s, size_t n, char* o) {
+	Utf8 const* map = t.byte_[table];
+
+	for(size_t i = 0; i < n; ) {
+		if(n - i >= 8 && ascii8(s + i)) {
+			memcpy(o, s + i, 8);
+			o += 8;
+			i += 8;
+			continue;
+		}
+
+		uint8_t c = s[i++];
+		if(c < 0x80) {
+			*o++ = c;
+			continue;
+		}
+
+		// table 00 puts the diacritic before the letter
+		if(!table && c >= 0xC1 && c <= 0xCF && t.mark_[c & 0x0F].len_ && i < n) {
+			uint8_t b = s[i];
+			if(b < 0x80 && t.composed_[c & 0x0F][b].len_) {
+				o = put(t.composed_[c & 0x0F][b], o);
+				++i;
+				continue;
+			}
+			if((b >= 0x21 && b < 0x7F) || (b >= 0xA0 && (b < 0xC1 || b > 0xCF) && map[b].len_)) {
+				o = put(map[b], o);
+				o = put(t.mark_[c & 0x0F], o);
+				++i;
+				continue;
+			}
+		}
+
+		o = put(map[c], o);
+	}
+
+	return o;
+}
+
+char* ucs2(const uint8_t* s, size_t n, char* o) {
+	for(size_t i = 0; i + 1 < n; i += 2) {
+		uint32_t c = (s[i] << 8) | s[i + 1];
+
+		if(c >= 0xE080 && c <= 0xE09F) {
+			if(c == 0xE08A)
+				*o++ = '\n';
+			continue;
+		}
+
+		if(c >= 0xD800 && c <= 0xDFFF) {
+			uint32_t lo = i + 3 < n ? (s[i + 2] << 8) | s[i + 3] : 0;
+			if(c > 0xDBFF || lo < 0xDC00 || lo > 0xDFFF)
+				continue;
+			c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+			i += 2;
+		}
+
+		o += put_utf8(c, o);
+	}
+	return o;
+}
+
+char* utf8(const uint8_t* s, size_t n, char* o) {
+	for(size_t i = 0; i < n; ) {
+		if(n - i >= 8 && ascii8(s + i)) {
+			memcpy(o, s + i, 8);
+			o += 8;
+			i += 8;
+			continue;
+		}
+
+		// control codes are U+E080..U+E09F
+		if(s[i] == 0xEE && i + 2 < n && s[i + 1] == 0x82 && s[i + 2] >= 0x80 && s[i + 2] <= 0x9F) {
+			if(s[i + 2] == 0x8A)
+				*o++ = '\n';
+			i += 3;
+			continue;
+		}
+
+		*o++ = s[i++];
+	}
+	return o;
+}
+
+// Keeps ASCII, every other two byte character becomes U+FFFD
+char* unsupported(const uint8_t* s, size_t n, char* o) {
+	for(size_t i = 0; i < n; ) {
+		if(s[i] < 0x80) {
+			*o++ = s[i++];
+			continue;
+		}
+		o += put_utf8(0xFFFD, o);
+		i += 2;
+	}
+	return o;
+}
+
+}
+
+size_t dvb_text_decode(const uint8_t* s, size_t n, char* out) {
+	Tables const& t = tables();
+
+	if(!n)
+		return 0;
+
+	uint8_t selector = s[0];
+	if(selector >= 0x20)
+		return single(t, 0, s, n, out) - out;
+
+	if(selector >= 0x01 && selector <= 0x0B && selector != 0x08)
+		return single(t, selector + 4, s + 1, n - 1, out) - out;
+
+	size_t skip = 1;
+	switch(selector) {
+	case 0x10:
+		if(n >= 3 && s[1] == 0x00 && s[2] >= 1 && s[2] <= 15 && s[2] != 12)
+			return single(t, s[2], s + 3, n - 3, out) - out;
+		skip = std::min<size_t>(n, 3);
+		break;
+	case 0x11:
+	case 0x14:
+		return ucs2(s + 1, n - 1, out) - out;
+	case 0x12:
+	case 0x13:
+		return unsupported(s + 1, n - 1, out) - out;
+	case 0x15:
+		return utf8(s + 1, n - 1, out) - out;
+	}
+
+	// reserved selectors, the rest is read as table 00
+	return single(t, 0, s + skip, n - skip, out) - out;
+}
@@ -0,0 +1,36 @@
+#ifndef _DVBTEXT_H_
+#define _DVBTEXT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+
+// Text fields of DVB SI (ETSI EN 300 468 Annex A) to UTF-8.
+//
+// The first byte selects the character table: none (0x20 and up) is the
+// Latin table 00 (ISO 6937 with the euro sign), 0x01..0x0B are ISO 8859-5
+// to 8859-15, 0x10 0x00 n is ISO 8859-n, 0x11 and 0x14 are big-endian
+// ISO 10646 BMP and 0x15 is UTF-8. KS X 1001 (0x12) and GB 2312 (0x13) are
+// not decoded, each of their two byte characters becomes U+FFFD.
+//
+// The control code CR/LF (0x8A) becomes '\n', emphasis and the other
+// control codes from 0x80..0x9F are dropped.
+
+// Most bytes dvb_text_decode() writes for n bytes of input
+inline size_t dvb_text_max(size_t n) {
+	return 3 * n;
+}
+
+// Writes the UTF-8 text to out, which must have room for dvb_text_max(n)
+// bytes, and returns the number of bytes written. Safe to call from any
+// thread.
+size_t dvb_text_decode(const uint8_t* s, size_t n, char* out);
+
+// Replaces the contents of out, reusing its storage
+inline void dvb_text_decode(const uint8_t* s, size_t n, std::string& out) {
+	out.resize(dvb_text_max(n));
+	out.resize(n ? dvb_text_decode(s, n, &out[0]) : 0);
+}
+
+#endif
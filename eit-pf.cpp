@@ -0,0 +1,416 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/dvb/dmx.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "eitpf.h"
+#include "secstream.h"
+#include "json.h"
+
+static volatile sig_atomic_t g_stop = 0;
+
+void sighandler(int n) {
+	g_stop = 1;
+}
+
+static const char* default_socket = "/var/run/eit-pf.sock";
+
+void usage() {
+	fprintf(stderr, "usage: eit-pf [-S socket] [-l languages] device_name\n"
+		"       eit-pf [-S socket] [-l languages] [-F] -f file|-\n"
+		"       eit-pf [-S socket] [-n count] -q query\n"
+		"\tkeeps the present and the following event of every service of the actual transport\n"
+		"\tstream (EIT 0x4E, PID 0x12) and answers queries on a local socket, one per line:\n"
+		"\t  sid [text]\n"
+		"\t  onid:tsid:sid [text]\n"
+		"\twith one JSON line; the event text is only decoded and sent when 'text' is asked for\n"
+		"\t-S\tsocket path, default %s\n"
+		"\t-l\tISO 639 codes, most wanted first (\"deu,eng\"): the name and text of an event in\n"
+		"\t\tthe first of them it has, in its first language if none\n"
+		"\t-F\tinput is framed by sec-collect or ts2sec -F\n"
+		"\t-f\tread sections from a file instead of a demux device, keep answering after its end\n"
+		"\t-q\tsend one query to a running eit-pf and print the answer\n"
+		"\t-n\tsend the query this many times and print the mean round trip to stderr\n", default_socket);
+	exit(1);
+}
+
+uint64_t now_us() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+int open_demux(const char* device) {
+	int fd = open(device, O_RDWR | O_NONBLOCK);
+	if(fd < 0) {
+		perror("failed to open demuxer");
+		return -1;
+	}
+
+	dmx_sct_filter_params params;
+	memset(&params, 0, sizeof(params));
+	params.pid = 0x12;
+	params.filter.filter[0] = 0x4E;
+	params.filter.mask[0] = 0xFF;
+	params.flags = DMX_IMMEDIATE_START | DMX_CHECK_CRC;
+	if(ioctl(fd, DMX_SET_FILTER, &params) != 0) {
+		perror("failed to set filter");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+bool socket_address(const char* path, sockaddr_un& addr) {
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "%s: socket path too long\n", path);
+		return false;
+	}
+	strcpy(addr.sun_path, path);
+	return true;
+}
+
+int listen_socket(const char* path) {
+	sockaddr_un addr;
+	if(!socket_address(path, addr))
+		return -1;
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0) {
+		perror("socket");
+		return -1;
+	}
+	// a socket left behind by a previous run
+	unlink(path);
+	if(bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	return fd;
+}
+
+// A query: a service and whether the event text is wanted
+struct Query {
+	bool full_key_;
+	uint16_t onid_, tsid_, sid_;
+	bool text_;
+};
+
+bool parse_query(const char* s, Query& q) {
+	int onid, tsid, sid, n = 0;
+	if(sscanf(s, "%i:%i:%i%n", &onid, &tsid, &sid, &n) == 3 && n) {
+		q.full_key_ = true;
+	}
+	else if(sscanf(s, "%i%n", &sid, &n) == 1 && n) {
+		q.full_key_ = false;
+		onid = tsid = 0;
+	}
+	else
+		return false;
+	if(onid < 0 || onid > 0xFFFF || tsid < 0 || tsid > 0xFFFF || sid < 0 || sid > 0xFFFF)
+		return false;
+	q.onid_ = onid;
+	q.tsid_ = tsid;
+	q.sid_ = sid;
+
+	s += n;
+	while(*s == ' ' || *s == '\t')
+		++s;
+	q.text_ = strncmp(s, "text", 4) == 0;
+	if(q.text_)
+		s += 4;
+	while(*s == ' ' || *s == '\t' || *s == '\r')
+		++s;
+	return *s == 0;
+}
+
+void write_pf_event(JsonWriter& os, PfEvent const* e, bool text) {
+	if(!e) {
+		os << "null";
+		return;
+	}
+	os << "{\"event_id\":" << (uint32_t)e->event_id_ << ",\"start\":" << (long long)e->start_ << ",\"duration\":" << e->duration_
+		<< ",\"running_status\":" << (uint32_t)e->running_status_ << ",\"free_ca_mode\":" << e->free_ca_mode_
+		<< ",\"language\":\"" << json_string(e->language_, strlen(e->language_)) << "\",\"name\":\"" << json_string(e->name_) << "\"";
+	if(text)
+		os << ",\"text\":\"" << json_string(e->text()) << "\"";
+	os << "}";
+}
+
+void answer(JsonWriter& os, PfTable const& table, const char* line, uint64_t now) {
+	Query q;
+	if(!parse_query(line, q)) {
+		os << "{\"error\":\"bad query\"}\n";
+		return;
+	}
+
+	PfService const* service = q.full_key_ ? table.find(epg_service_key(q.onid_, q.tsid_, q.sid_)) : table.find(q.sid_);
+	if(!service) {
+		os << "{\"error\":\"unknown service\",\"service_id\":" << (uint32_t)q.sid_ << "}\n";
+		return;
+	}
+
+	os << "{\"original_network_id\":" << (uint32_t)table.original_network_id() << ",\"transport_stream_id\":"
+		<< (uint32_t)table.transport_stream_id() << ",\"service_id\":" << (uint32_t)q.sid_
+		<< ",\"version\":" << (uint32_t)service->version_ << ",\"age_ms\":" << (unsigned long long)((now - service->updated_) / 1000)
+		<< ",\"present\":";
+	write_pf_event(os, service->present(), q.text_);
+	os << ",\"following\":";
+	write_pf_event(os, service->following(), q.text_);
+	os << "}\n";
+}
+
+struct Client {
+	int fd_;
+	std::string in_;
+};
+
+// Answers every complete line a client has sent, false once it is gone
+bool serve(Client& c, PfTable const& table, JsonWriter& os) {
+	char buf[1024];
+	ssize_t n = read(c.fd_, buf, sizeof(buf));
+	if(n < 0)
+		return errno == EAGAIN || errno == EINTR;
+	if(n == 0)
+		return false;
+	c.in_.append(buf, n);
+
+	uint64_t now = now_us();
+	size_t begin = 0, end;
+	os.truncate(0);
+	while((end = c.in_.find('\n', begin)) != std::string::npos) {
+		c.in_[end] = 0;
+		answer(os, table, &c.in_[begin], now);
+		begin = end + 1;
+	}
+	c.in_.erase(0, begin);
+	if(c.in_.size() > sizeof(buf))
+		return false;
+
+	// answers are a few hundred bytes, a client that does not take them is dropped
+	return os.size() == 0 || send(c.fd_, os.data(), os.size(), MSG_NOSIGNAL | MSG_DONTWAIT) == (ssize_t)os.size();
+}
+
+// Reads what is there, false at the end of a file
+bool read_sections(int fd, SectionStream* in, PfTable& table) {
+	uint8_t buf[4096];
+	const uint8_t* s;
+	size_t n;
+
+	for(;;) {
+		if(in) {
+			if(!in->next(s, n))
+				return false;
+		}
+		else {
+			// a section filter returns one section per read
+			ssize_t r = read(fd, buf, sizeof(buf));
+			if(r < 0) {
+				if(errno == EOVERFLOW)
+					continue;
+				if(errno != EAGAIN && errno != EINTR)
+					perror("read");
+				return true;
+			}
+			if(r < 3)
+				return true;
+			s = buf;
+			n = r;
+		}
+
+		try {
+			table.add(s, n, now_us());
+		}
+		catch(std::exception const& e) {
+			fprintf(stderr, "section %02x: %s\n", s[0], e.what());
+		}
+
+		if(in && !in->buffered())
+			return true;
+	}
+}
+
+int query(const char* path, const char* q, unsigned count) {
+	sockaddr_un addr;
+	if(!socket_address(path, addr))
+		return 1;
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+		perror(path);
+		return 1;
+	}
+
+	std::string line = std::string(q) + "\n";
+	std::string reply;
+	uint64_t start = now_us();
+	for(unsigned i = 0; i < count; ++i) {
+		if(write(fd, line.data(), line.size()) != (ssize_t)line.size()) {
+			perror("write");
+			return 1;
+		}
+		reply.clear();
+		char buf[4096];
+		while(reply.empty() || reply[reply.size() - 1] != '\n') {
+			ssize_t n = read(fd, buf, sizeof(buf));
+			if(n <= 0) {
+				fprintf(stderr, "eit-pf: connection closed\n");
+				return 1;
+			}
+			reply.append(buf, n);
+		}
+	}
+	uint64_t elapsed = now_us() - start;
+	close(fd);
+
+	fwrite(reply.data(), reply.size(), 1, stdout);
+	if(count > 1)
+		fprintf(stderr, "%u queries, %.1f us per round trip\n", count, double(elapsed) / count);
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	const char* socket_path = default_socket;
+	const char* file = 0;
+	const char* q = 0;
+	bool framed = false;
+	unsigned count = 1;
+	LanguagePreference languages;
+
+	int opt;
+	while((opt = getopt(argc, argv, "S:l:Ff:q:n:")) != -1) {
+		switch(opt) {
+		case 'S': socket_path = optarg; break;
+		case 'l': if(!languages.parse(optarg)) usage(); break;
+		case 'F': framed = true; break;
+		case 'f': file = optarg; break;
+		case 'q': q = optarg; break;
+		case 'n': count = atoi(optarg); break;
+		default: usage();
+		}
+	}
+
+	if(q) {
+		if(optind != argc || file || count == 0)
+			usage();
+		return query(socket_path, q, count);
+	}
+	if(file ? optind != argc : optind != argc - 1)
+		usage();
+
+	int in_fd;
+	if(file)
+		in_fd = strcmp(file, "-") == 0 ? STDIN_FILENO : open(file, O_RDONLY);
+	else
+		in_fd = open_demux(argv[optind]);
+	if(in_fd < 0) {
+		if(file)
+			perror(file);
+		return 1;
+	}
+
+	int listen_fd = listen_socket(socket_path);
+	if(listen_fd < 0)
+		return 1;
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sighandler;
+	sigaction(SIGTERM, &sa, 0);
+	sigaction(SIGINT, &sa, 0);
+
+	SectionStream* in = file ? new SectionStream(in_fd, framed) : 0;
+	PfTable table;
+	table.set_languages(languages);
+	JsonWriter os(-1, 4096);
+	std::vector<Client> clients;
+	std::vector<pollfd> fds;
+
+	int status = 0;
+	while(!g_stop) {
+		// [input] listener clients...
+		fds.clear();
+		pollfd p = {in_fd, POLLIN, 0};
+		fds.push_back(p);
+		p.fd = listen_fd;
+		fds.push_back(p);
+		for(size_t i = 0; i < clients.size(); ++i) {
+			p.fd = clients[i].fd_;
+			fds.push_back(p);
+		}
+		// the input is -1 after the end of a file, poll() ignores it
+		if(poll(&fds[0], fds.size(), -1) < 0) {
+			if(errno == EINTR) continue;
+			perror("poll");
+			status = 1;
+			break;
+		}
+
+		// answering first keeps the latency of a query independent of the section rate
+		for(size_t i = clients.size(); i--;) {
+			if(!(fds[2 + i].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			if(!serve(clients[i], table, os)) {
+				close(clients[i].fd_);
+				clients.erase(clients.begin() + i);
+			}
+		}
+
+		if(fds[1].revents & POLLIN) {
+			int fd;
+			while((fd = accept(listen_fd, 0, 0)) >= 0) {
+				fcntl(fd, F_SETFL, O_NONBLOCK);
+				Client c = {fd};
+				clients.push_back(c);
+			}
+		}
+
+		if(fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+			bool more;
+			try {
+				more = read_sections(in_fd, in, table);
+			}
+			catch(std::exception const& e) {
+				fprintf(stderr, "%s: %s\n", file ? file : argv[optind], e.what());
+				more = false;
+			}
+			if(!more) {
+				if(in_fd != STDIN_FILENO)
+					close(in_fd);
+				in_fd = -1;
+			}
+		}
+	}
+
+	for(size_t i = 0; i < clients.size(); ++i)
+		close(clients[i].fd_);
+	close(listen_fd);
+	unlink(socket_path);
+	if(in_fd >= 0 && in_fd != STDIN_FILENO)
+		close(in_fd);
+	delete in;
+
+	PfStats const& s = table.stats();
+	fprintf(stderr, "eit-pf: %u services, %llu sections, %llu unchanged, %llu updates, %llu retunes\n",
+		(unsigned)table.services(), (unsigned long long)s.sections_, (unsigned long long)s.unchanged_,
+		(unsigned long long)s.updates_, (unsigned long long)s.retunes_);
+	return status;
+}
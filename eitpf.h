@@ -0,0 +1,185 @@
+#ifndef _EITPF_H_
+#define _EITPF_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "section.h"
+#include "dvbtext.h"
+#include "descriptors.h"
+#include "epg.h"
+
+// Present/following events of the actual transport stream (EIT 0x4E), the
+// latest version per service, for answering "what is on now" without the
+// schedule. Sections of a version already held are dropped after their
+// header; a new one decodes its event and the event name only, the text
+// of the short_event_descriptor is decoded the first time it is asked for.
+
+struct PfEvent {
+	// seconds since the epoch, -1 if undefined
+	int64_t start_;
+	uint32_t duration_;
+	uint16_t event_id_;
+	uint8_t running_status_;
+	bool free_ca_mode_;
+	// short_event_descriptor in the preferred language: language, name as UTF-8, text as broadcast
+	char language_[4];
+	std::string name_;
+	std::vector<uint8_t> text_raw_;
+
+	PfEvent() : start_(-1), duration_(0), event_id_(0), running_status_(0), free_ca_mode_(false), text_done_(true) {
+		language_[0] = 0;
+	}
+
+	// UTF-8 of the short_event_descriptor text
+	std::string const& text() const {
+		if(!text_done_) {
+			dvb_text_decode(text_raw_.empty() ? 0 : &text_raw_[0], text_raw_.size(), text_);
+			text_done_ = true;
+		}
+		return text_;
+	}
+
+	void decode(EitEvent const& event, LanguagePreference const& languages) {
+		start_ = mjd_to_unix(event.start_mjd(), event.start_bcd());
+		duration_ = bcd_to_seconds(event.duration_bcd());
+		event_id_ = event.event_id();
+		running_status_ = event.running_status();
+		free_ca_mode_ = event.free_ca_mode();
+		language_[0] = 0;
+		name_.clear();
+		text_raw_.clear();
+		text_done_ = false;
+
+		Descriptor d((ByteView()));
+		if(find_short_event(event.descriptors(), languages, d)) {
+			ShortEventDescriptor se(d);
+			memcpy(language_, se.language().data(), 3);
+			language_[3] = 0;
+			dvb_text_decode(se.event_name().data(), se.event_name().size(), name_);
+			ByteView text = se.text();
+			text_raw_.assign(text.data(), text.data() + text.size());
+		}
+	}
+
+private:
+	mutable std::string text_;
+	mutable bool text_done_;
+};
+
+struct PfService {
+	uint8_t version_;
+	// section 0 is the present event, 1 the following one; a section can be
+	// received in the current version and still say there is no event
+	bool received_[2];
+	bool have_[2];
+	PfEvent events_[2];
+	// time given to add() with the last section that changed the service
+	uint64_t updated_;
+
+	PfService() : version_(0xFF), updated_(0) {
+		received_[0] = received_[1] = false;
+		have_[0] = have_[1] = false;
+	}
+
+	PfEvent const* present() const { return have_[0] ? &events_[0] : 0; }
+	PfEvent const* following() const { return have_[1] ? &events_[1] : 0; }
+};
+
+struct PfStats {
+	uint64_t sections_;
+	uint64_t unchanged_;
+	uint64_t updates_;
+	// sections of another transport stream, the tuner moved
+	uint64_t retunes_;
+};
+
+class PfTable {
+public:
+	PfTable() : onid_(0), tsid_(0), stats_() {}
+
+	// Takes any section, only current EIT p/f actual is used. Returns true
+	// if an event changed. Throws SectionError on a malformed section.
+	bool add(const uint8_t* s, size_t n, uint64_t now) {
+		if(n < 1 || s[0] != 0x4E)
+			return false;
+
+		EitSection eit(ByteView(s, n));
+		if(!eit.current_next() || eit.section_number() > 1)
+			return false;
+		++stats_.sections_;
+
+		if(eit.original_network_id() != onid_ || eit.transport_stream_id() != tsid_) {
+			if(!services_.empty())
+				++stats_.retunes_;
+			services_.clear();
+			onid_ = eit.original_network_id();
+			tsid_ = eit.transport_stream_id();
+		}
+
+		PfService& service = services_[eit.service_id()];
+		uint8_t number = eit.section_number();
+		if(service.version_ == eit.version() && service.received_[number]) {
+			++stats_.unchanged_;
+			return false;
+		}
+
+		// decode before touching the service so a bad event leaves it as it was;
+		// an empty section says there is no such event
+		PfEvent e;
+		Loop<EitEvent> events = eit.events();
+		bool have = events.begin() != events.end();
+		if(have)
+			e.decode(*events.begin(), languages_);
+
+		// a new version starts empty, the other section may still be the old one
+		if(service.version_ != eit.version()) {
+			service.version_ = eit.version();
+			service.received_[0] = service.received_[1] = false;
+			service.have_[0] = service.have_[1] = false;
+		}
+		std::swap(service.events_[number], e);
+		service.received_[number] = true;
+		service.have_[number] = have;
+
+		service.updated_ = now;
+		++stats_.updates_;
+		return true;
+	}
+
+	PfService const* find(uint16_t service_id) const {
+		Services::const_iterator i = services_.find(service_id);
+		return i == services_.end() ? 0 : &i->second;
+	}
+
+	// By the key of epg.h, 0 unless it is in the actual transport stream
+	PfService const* find(uint64_t key) const {
+		if(epg_onid(key) != onid_ || epg_tsid(key) != tsid_)
+			return 0;
+		return find(epg_sid(key));
+	}
+
+	// Which short_event_descriptor of an event is kept when it has several
+	void set_languages(LanguagePreference const& languages) { languages_ = languages; }
+
+	uint16_t original_network_id() const { return onid_; }
+	uint16_t transport_stream_id() const { return tsid_; }
+	size_t services() const { return services_.size(); }
+	PfStats const& stats() const { return stats_; }
+
+private:
+	typedef std::unordered_map<uint16_t, PfService> Services;
+
+	Services services_;
+	uint16_t onid_;
+	uint16_t tsid_;
+	LanguagePreference languages_;
+	PfStats stats_;
+};
+
+#endif
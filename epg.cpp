@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "epg.h"
+#include "epgcache.h"
+#include "secstream.h"
+#include "json.h"
+
+void usage() {
+	fprintf(stderr, "usage: epg [-F] [-c cache] [-l languages] [-s onid:tsid:sid] [-n] [-T time] [-f from -t to] < sections\n"
+		"\t-F\tinput is framed by sec-collect or ts2sec -F\n"
+		"\t-l\tISO 639 codes, most wanted first (\"deu,eng\"): the name and text of an event in\n"
+		"\t\tthe first of them it has, in its first language if none\n"
+		"\t-c\tstart from this schedule cache, update it with the input and answer from it\n"
+		"\t-s\tonly this service\n"
+		"\t-n\tprint the present and the following event at -T\n"
+		"\t-T\ttime for -n, default now\n"
+		"\t-f -t\tprint the events overlapping [from, to)\n"
+		"times are seconds since the epoch or YYYY-MM-DDTHH:MM:SS in UTC\n"
+		"without -n, -f or -t one record per service tells how much of the schedule is in\n");
+	exit(1);
+}
+
+int64_t parse_time(const char* s) {
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	const char* end = strptime(s, "%Y-%m-%dT%H:%M:%S", &tm);
+	if(end && (*end == 0 || (*end == 'Z' && end[1] == 0)))
+		return timegm(&tm);
+
+	char* e;
+	long long t = strtoll(s, &e, 0);
+	if(*s == 0 || *e != 0)
+		usage();
+	return t;
+}
+
+uint64_t parse_service(const char* s) {
+	int onid, tsid, sid;
+	char tail;
+	if(sscanf(s, "%i:%i:%i%c", &onid, &tsid, &sid, &tail) != 3 || onid < 0 || onid > 0xFFFF || tsid < 0 || tsid > 0xFFFF || sid < 0 || sid > 0xFFFF)
+		usage();
+	return epg_service_key(onid, tsid, sid);
+}
+
+void write_service(JsonWriter& os, uint64_t key) {
+	os << "\"original_network_id\":" << (uint32_t)epg_onid(key) << ",\"transport_stream_id\":" << (uint32_t)epg_tsid(key)
+		<< ",\"service_id\":" << (uint32_t)epg_sid(key);
+}
+
+void write_event(JsonWriter& os, uint64_t key, EpgEvent const& e, const char* what) {
+	os << "{";
+	write_service(os, key);
+	if(what)
+		os << ",\"" << what << "\":true";
+	os << ",\"event_id\":" << (uint32_t)e.event_id_ << ",\"start\":" << (long long)e.start_ << ",\"duration\":" << e.duration_
+		<< ",\"running_status\":" << (uint32_t)e.running_status_ << ",\"free_ca_mode\":" << e.free_ca_mode_
+		<< ",\"language\":\"" << json_string(e.language_.data(), e.language_.size()) << "\",\"name\":\"" << json_string(e.name_.data(), e.name_.size())
+		<< "\",\"text\":\"" << json_string(e.text_.data(), e.text_.size()) << "\"}\n";
+}
+
+int main(int argc, char* argv[]) {
+	bool framed = false;
+	bool now_next = false;
+	bool one = false;
+	uint64_t service = 0;
+	int64_t now = time(0);
+	int64_t from = INT64_MIN;
+	int64_t to = INT64_MAX;
+	bool interval = false;
+	const char* cache_path = 0;
+	LanguagePreference languages;
+
+	int opt;
+	while((opt = getopt(argc, argv, "Fc:l:s:nT:f:t:")) != -1) {
+		switch(opt) {
+		case 'F': framed = true; break;
+		case 'c': cache_path = optarg; break;
+		case 'l': if(!languages.parse(optarg)) usage(); break;
+		case 's': service = parse_service(optarg); one = true; break;
+		case 'n': now_next = true; break;
+		case 'T': now = parse_time(optarg); break;
+		case 'f': from = parse_time(optarg); interval = true; break;
+		case 't': to = parse_time(optarg); interval = true; break;
+		default: usage();
+		}
+	}
+	if(optind != argc)
+		usage();
+
+	EpgDatabase epg;
+	epg.set_languages(languages);
+	EpgCache cache;
+	bool cached = cache_path && cache.open(cache_path);
+	// its events are in the languages of another -l, rebuilt from the input
+	if(cached && !cache.same_languages(languages)) {
+		fprintf(stderr, "epg: %s was written for other languages, not used\n", cache_path);
+		cache.close();
+		cached = false;
+	}
+	uint64_t known = 0;
+
+	SectionStream in(STDIN_FILENO, framed);
+	const uint8_t* s;
+	size_t n;
+
+	while(in.next(s, n)) {
+		try {
+			// schedule sections the cache holds in the same version need no decoding
+			if(cached && s[0] >= 0x50 && s[0] <= 0x6F) {
+				EitSection eit(ByteView(s, n));
+				if(eit.current_next() && cache.known(eit)) {
+					++known;
+					continue;
+				}
+				epg.add(eit);
+			}
+			else
+				epg.add(s, n);
+		}
+		catch(std::exception const& e) {
+			fprintf(stderr, "epg: skipping section: %s\n", e.what());
+		}
+	}
+
+	if(cache_path) {
+		if(!EpgCache::write(cache_path, epg, cached ? &cache : 0)) {
+			fprintf(stderr, "epg: cannot write %s: %s\n", cache_path, strerror(errno));
+			return 1;
+		}
+		cached = cache.open(cache_path);
+	}
+
+	std::vector<uint64_t> keys;
+	if(one)
+		keys.push_back(service);
+	else {
+		keys = epg.service_keys();
+		for(size_t i = 0; i < cache.services(); ++i)
+			keys.push_back(cache.service(i).key_);
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	}
+
+	JsonWriter out;
+	for(size_t i = 0; i < keys.size() && out.good(); ++i) {
+		if(now_next) {
+			EpgEvent const* present;
+			EpgEvent const* following;
+			epg.now_next(keys[i], now, present, following);
+
+			// the schedule is in the cache, only present/following comes from the input
+			EpgCacheEvent const* cp;
+			EpgCacheEvent const* cf;
+			if(cached && (!present || present->table_id_ >= 0x50) && cache.now_next(keys[i], now, cp, cf)) {
+				if(cp)
+					write_event(out, keys[i], cache.event(*cp), "present");
+				if(cf)
+					write_event(out, keys[i], cache.event(*cf), "following");
+			}
+			else {
+				if(present)
+					write_event(out, keys[i], *present, "present");
+				if(following)
+					write_event(out, keys[i], *following, "following");
+			}
+		}
+
+		if(interval && cached) {
+			std::vector<EpgCacheEvent const*> events = cache.events(keys[i], from, to);
+			for(size_t j = 0; j < events.size(); ++j)
+				write_event(out, keys[i], cache.event(*events[j]), 0);
+		}
+		else if(interval) {
+			std::vector<EpgEvent const*> events = epg.events(keys[i], from, to);
+			for(size_t j = 0; j < events.size(); ++j)
+				write_event(out, keys[i], *events[j], 0);
+		}
+
+		if(!now_next && !interval) {
+			EpgProgress p;
+			size_t events;
+			if(cached) {
+				p = cache.progress(keys[i]);
+				EpgCacheService const* cs = cache.find(keys[i]);
+				events = cs ? cs->events_ : 0;
+			}
+			else {
+				p = epg.progress(keys[i]);
+				events = epg.event_count(keys[i]);
+			}
+			out << "{";
+			write_service(out, keys[i]);
+			out << ",\"events\":" << events
+				<< ",\"segments\":" << p.segments_ << ",\"complete_segments\":" << p.complete_
+				<< ",\"complete\":" << (p.segments_ && p.complete_ == p.segments_) << "}\n";
+		}
+
+		out.flush(false);
+	}
+
+	EpgStats const& st = epg.stats();
+	fprintf(stderr, "epg: %llu sections, %llu duplicates, %llu version changes, %llu events, %zu services, %llu already cached\n",
+		(unsigned long long)st.sections_, (unsigned long long)st.duplicates_, (unsigned long long)st.version_changes_,
+		(unsigned long long)st.events_, epg.services(), (unsigned long long)known);
+}
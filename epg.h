@@ -0,0 +1,475 @@
+#ifndef _EPG_H_
+#define _EPG_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "section.h"
+#include "dvbtext.h"
+#include "descriptors.h"
+#include "arena.h"
+
+// Services are identified by original_network_id, transport_stream_id
+// and service_id packed into one integer
+inline uint64_t epg_service_key(uint16_t onid, uint16_t tsid, uint16_t sid) {
+	return (uint64_t(onid) << 32) | (uint32_t(tsid) << 16) | sid;
+}
+
+inline uint16_t epg_onid(uint64_t key) { return key >> 32; }
+inline uint16_t epg_tsid(uint64_t key) { return key >> 16; }
+inline uint16_t epg_sid(uint64_t key) { return key; }
+
+struct EpgEvent {
+	// seconds since the epoch, -1 if undefined
+	int64_t start_;
+	uint32_t duration_;
+	uint16_t event_id_;
+	uint8_t running_status_;
+	bool free_ca_mode_;
+	// where the event came from, 0x4E..0x6F and section_number
+	uint8_t table_id_;
+	uint8_t section_;
+	// short_event_descriptor in the preferred language decoded to UTF-8,
+	// and the whole descriptor loop as broadcast; they live in the arena of
+	// the database or in the mapping of the cache the event came from
+	ArenaString language_;
+	ArenaString name_;
+	ArenaString text_;
+	ArenaString descriptors_;
+
+	EpgEvent() : start_(-1), duration_(0), event_id_(0), running_status_(0), free_ca_mode_(false), table_id_(0), section_(0) {
+		language_ = name_ = text_ = descriptors_ = arena_string(0, 0);
+	}
+
+	int64_t end() const { return start_ + duration_; }
+};
+
+struct EpgStats {
+	uint64_t sections_;
+	uint64_t duplicates_;
+	// sections that replaced a table with an older version
+	uint64_t version_changes_;
+	uint64_t events_;
+};
+
+// Schedule segments of a service that have been seen in full
+struct EpgProgress {
+	size_t segments_;
+	size_t complete_;
+};
+
+// Which sections of one EIT table of one service are in. Plain bytes so
+// the EPG cache can store it as it is.
+struct EpgTable {
+	static const uint8_t NONE = 0xFF;
+
+	uint8_t table_id_;
+	// NONE until the first section
+	uint8_t version_;
+	uint8_t last_section_;
+	uint8_t reserved_;
+	// highest segment_last_section_number seen per segment
+	uint8_t segment_last_[32];
+	// bit per section_number
+	uint8_t have_[32];
+
+	void reset(uint8_t table_id, uint8_t version) {
+		memset(this, 0, sizeof(*this));
+		table_id_ = table_id;
+		version_ = version;
+	}
+
+	bool known() const { return version_ != NONE; }
+	bool have(uint8_t section) const { return have_[section / 8] & (1 << (section % 8)); }
+
+	void set(uint8_t section, uint8_t last_section, uint8_t segment_last) {
+		have_[section / 8] |= 1 << (section % 8);
+		last_section_ = last_section;
+		segment_last_[section / 8] = std::max(segment_last_[section / 8], segment_last);
+	}
+
+	size_t segments() const { return last_section_ / 8 + 1; }
+
+	bool segment_complete(size_t segment) const {
+		if(!known() || segment >= segments())
+			return false;
+		size_t first = segment * 8;
+		size_t last = std::max<size_t>(first, std::min<size_t>(segment_last_[segment], first + 7));
+		for(size_t i = first; i <= last; ++i) {
+			if(!have(i))
+				return false;
+		}
+		return true;
+	}
+};
+
+// Progress of the actual and other schedule. tables[i] is table 0x50 + i,
+// last_table the last_table_id of both.
+inline EpgProgress epg_progress(const uint8_t last_table[2], EpgTable const* const tables[32]) {
+	EpgProgress p = {0, 0};
+	for(int other = 0; other < 2; ++other) {
+		uint8_t first = other ? 0x60 : 0x50;
+		if(last_table[other] < first)
+			continue;
+		for(uint8_t tid = first; tid <= last_table[other] && tid < first + 16; ++tid) {
+			EpgTable const* t = tables[tid - 0x50];
+			// before the first section of a table its size is unknown, count one segment
+			size_t segments = t && t->known() ? t->segments() : 1;
+			p.segments_ += segments;
+			for(size_t s = 0; s < segments; ++s)
+				p.complete_ += t && t->segment_complete(s);
+		}
+	}
+	return p;
+}
+
+// EPG assembled from EIT sections: present/following (0x4E, 0x4F) and
+// schedule (0x50..0x6F) of every service, ordered by start time.
+//
+// A schedule table is split into 32 segments of three hours, each carried
+// by up to 8 sections. A segment is complete once every section up to its
+// segment_last_section_number is in, and a service once every segment of
+// every table up to last_table_id is. A new version of a table replaces
+// all events of the old one.
+//
+// The strings of the events are kept in one arena, language codes and
+// names once per value, so an event costs its map node and nothing else.
+// What replaced events leave behind in the arena is reclaimed by copying
+// the live strings to a new one once it is more than half of it.
+class EpgDatabase {
+public:
+	typedef std::pair<int64_t, uint16_t> Key;
+	typedef std::map<Key, EpgEvent> Schedule;
+
+	EpgDatabase() : strings_(arena_), garbage_(0), stats_() {}
+
+	// Takes any section, only current EIT sections are used. Returns true
+	// if the EPG changed. Throws SectionError on a malformed EIT section.
+	bool add(const uint8_t* s, size_t n) {
+		if(n < 1 || s[0] < 0x4E || s[0] > 0x6F)
+			return false;
+		return add(EitSection(ByteView(s, n)));
+	}
+
+	bool add(EitSection const& eit) {
+		if(!eit.current_next())
+			return false;
+
+		++stats_.sections_;
+
+		uint64_t key = epg_service_key(eit.original_network_id(), eit.transport_stream_id(), eit.service_id());
+		uint8_t tid = eit.table_id();
+		uint8_t number = eit.section_number();
+
+		Service const* known = find(key);
+		if(known) {
+			EpgTable const& t = known->tables_[tid - 0x4E];
+			if(t.version_ == eit.version() && t.have(number)) {
+				++stats_.duplicates_;
+				return false;
+			}
+		}
+
+		// decode everything before touching the service so a bad event leaves it as it was
+		std::vector<EpgEvent>& events = decoded_;
+		events.clear();
+		try {
+			Loop<EitEvent> loop = eit.events();
+			for(Loop<EitEvent>::iterator i = loop.begin(); i != loop.end(); ++i) {
+				events.push_back(EpgEvent());
+				decode(*i, events.back());
+				events.back().table_id_ = tid;
+				events.back().section_ = number;
+			}
+		}
+		catch(SectionError const&) {
+			// what the events before the broken one copied to the arena is unused
+			for(size_t i = 0; i < events.size(); ++i)
+				discard(events[i]);
+			events.clear();
+			collect();
+			throw;
+		}
+
+		Service& service = services_[key];
+		EpgTable& t = service.tables_[tid - 0x4E];
+
+		if(t.version_ != eit.version()) {
+			if(t.known()) {
+				++stats_.version_changes_;
+				drop(service, tid);
+			}
+			t.reset(tid, eit.version());
+		}
+
+		t.set(number, eit.last_section_number(), eit.segment_last_section_number());
+		if(tid >= 0x50)
+			service.last_table_[tid >= 0x60] = eit.last_table_id();
+
+		stats_.events_ += events.size();
+		for(size_t i = 0; i < events.size(); ++i) {
+			EpgEvent const& e = events[i];
+			if(tid < 0x50) {
+				// section 0 is the present event, 1 the following one
+				if(number < 2) {
+					discard(service.pf_[number]);
+					service.pf_[number] = e;
+					service.have_pf_[number] = true;
+				}
+				else
+					discard(e);
+			}
+			else if(e.start_ >= 0) {
+				service.longest_ = std::max(service.longest_, e.duration_);
+				EpgEvent& slot = service.schedule_[Key(e.start_, e.event_id_)];
+				discard(slot);
+				slot = e;
+			}
+			else
+				discard(e);
+		}
+
+		collect();
+		return true;
+	}
+
+	// Which short_event_descriptor of an event is kept when it has several
+	void set_languages(LanguagePreference const& languages) { languages_ = languages; }
+	LanguagePreference const& languages() const { return languages_; }
+
+	// Bytes of strings taken from the system, and how many of them belong
+	// to events no longer in the database
+	size_t string_bytes() const { return arena_.bytes(); }
+	size_t garbage_bytes() const { return garbage_; }
+
+	size_t services() const { return services_.size(); }
+
+	std::vector<uint64_t> service_keys() const {
+		std::vector<uint64_t> keys;
+		for(Services::const_iterator i = services_.begin(); i != services_.end(); ++i)
+			keys.push_back(i->first);
+		return keys;
+	}
+
+	// Schedule events of a service overlapping [from, to), by start time
+	std::vector<EpgEvent const*> events(uint64_t key, int64_t from, int64_t to) const {
+		std::vector<EpgEvent const*> r;
+		Service const* service = find(key);
+		if(!service)
+			return r;
+
+		Schedule const& schedule = service->schedule_;
+		int64_t first = from < INT64_MIN + int64_t(service->longest_) ? INT64_MIN : from - int64_t(service->longest_);
+		Schedule::const_iterator i = schedule.lower_bound(Key(first, 0));
+		for(; i != schedule.end() && i->first.first < to; ++i) {
+			if(i->second.end() > from)
+				r.push_back(&i->second);
+		}
+		return r;
+	}
+
+	size_t event_count(uint64_t key) const {
+		Service const* service = find(key);
+		return service ? service->schedule_.size() : 0;
+	}
+
+	// Event running at 'now' and the one after it, either may be 0. The
+	// present/following table is used while it covers 'now', the schedule
+	// otherwise. Returns false if nothing is known about the service.
+	bool now_next(uint64_t key, int64_t now, EpgEvent const*& present, EpgEvent const*& following) const {
+		present = following = 0;
+		Service const* service = find(key);
+		if(!service)
+			return false;
+
+		if(service->have_pf_[0] && service->pf_[0].start_ <= now && now < service->pf_[0].end()) {
+			present = &service->pf_[0];
+			if(service->have_pf_[1])
+				following = &service->pf_[1];
+			return true;
+		}
+
+		Schedule const& schedule = service->schedule_;
+		Schedule::const_iterator i = schedule.upper_bound(Key(now, 0xFFFF));
+		if(i != schedule.begin()) {
+			Schedule::const_iterator p = i;
+			--p;
+			if(now < p->second.end())
+				present = &p->second;
+		}
+		if(i != schedule.end())
+			following = &i->second;
+
+		return present || following || service->have_pf_[0] || service->have_pf_[1];
+	}
+
+	// All sections of one segment of a schedule table are in
+	bool segment_complete(uint64_t key, uint8_t table_id, size_t segment) const {
+		Service const* service = find(key);
+		if(!service || table_id < 0x4E || table_id > 0x6F || segment >= 32)
+			return false;
+		return service->tables_[table_id - 0x4E].segment_complete(segment);
+	}
+
+	// Receive state of a table, 0 if the service is unknown
+	EpgTable const* table(uint64_t key, uint8_t table_id) const {
+		Service const* service = find(key);
+		if(!service || table_id < 0x4E || table_id > 0x6F)
+			return 0;
+		return &service->tables_[table_id - 0x4E];
+	}
+
+	// last_table_id of the actual (0) or other (1) schedule, 0 if unknown
+	uint8_t last_table(uint64_t key, int other) const {
+		Service const* service = find(key);
+		return service ? service->last_table_[other] : 0;
+	}
+
+	Schedule const* schedule(uint64_t key) const {
+		Service const* service = find(key);
+		return service ? &service->schedule_ : 0;
+	}
+
+	EpgProgress progress(uint64_t key) const {
+		Service const* service = find(key);
+		if(!service) {
+			EpgProgress p = {0, 0};
+			return p;
+		}
+
+		EpgTable const* tables[32];
+		for(size_t i = 0; i < 32; ++i)
+			tables[i] = &service->tables_[0x50 - 0x4E + i];
+		return epg_progress(service->last_table_, tables);
+	}
+
+	// Every schedule segment announced for the service is in
+	bool complete(uint64_t key) const {
+		EpgProgress p = progress(key);
+		return p.segments_ && p.complete_ == p.segments_;
+	}
+
+	EpgStats const& stats() const { return stats_; }
+
+private:
+	struct Service {
+		Service() : longest_(0) {
+			have_pf_[0] = have_pf_[1] = false;
+			last_table_[0] = last_table_[1] = 0;
+			for(size_t i = 0; i < sizeof(tables_) / sizeof(tables_[0]); ++i)
+				tables_[i].reset(0x4E + i, EpgTable::NONE);
+		}
+
+		// indexed by table_id - 0x4E
+		EpgTable tables_[0x70 - 0x4E];
+		// last_table_id of the actual and the other schedule
+		uint8_t last_table_[2];
+		EpgEvent pf_[2];
+		bool have_pf_[2];
+		Schedule schedule_;
+		// longest duration in the schedule, bounds interval lookups
+		uint32_t longest_;
+	};
+
+	typedef std::unordered_map<uint64_t, Service> Services;
+
+	Service const* find(uint64_t key) const {
+		Services::const_iterator i = services_.find(key);
+		return i == services_.end() ? 0 : &i->second;
+	}
+
+	void drop(Service& service, uint8_t tid) {
+		if(tid < 0x50) {
+			for(int i = 0; i < 2; ++i) {
+				discard(service.pf_[i]);
+				service.pf_[i] = EpgEvent();
+				service.have_pf_[i] = false;
+			}
+			return;
+		}
+		for(Schedule::iterator i = service.schedule_.begin(); i != service.schedule_.end(); ) {
+			if(i->second.table_id_ == tid) {
+				discard(i->second);
+				service.schedule_.erase(i++);
+			}
+			else
+				++i;
+		}
+	}
+
+	// The strings of an event that is going away; interned ones stay in use
+	void discard(EpgEvent const& e) {
+		garbage_ += e.text_.size() + e.descriptors_.size();
+	}
+
+	void decode(EitEvent const& event, EpgEvent& e) {
+		e.start_ = mjd_to_unix(event.start_mjd(), event.start_bcd());
+		e.duration_ = bcd_to_seconds(event.duration_bcd());
+		e.event_id_ = event.event_id();
+		e.running_status_ = event.running_status();
+		e.free_ca_mode_ = event.free_ca_mode();
+
+		DescriptorLoop descriptors = event.descriptors();
+		ByteView raw = descriptors.view();
+
+		Descriptor d((ByteView()));
+		if(find_short_event(descriptors, languages_, d)) {
+			ShortEventDescriptor se(d);
+			ByteView language = se.language();
+			e.language_ = strings_.intern(language.data(), language.size());
+			dvb_text_decode(se.event_name().data(), se.event_name().size(), text_);
+			e.name_ = strings_.intern(text_);
+			dvb_text_decode(se.text().data(), se.text().size(), text_);
+			e.text_ = arena_.copy(text_);
+		}
+		e.descriptors_ = arena_.copy(raw.data(), raw.size());
+	}
+
+	// Compacts once the arena is mostly garbage
+	void collect() {
+		if(garbage_ > (1 << 20) && garbage_ > arena_.bytes() / 2)
+			compact();
+	}
+
+	// Moves the strings of every event to a new arena
+	void compact() {
+		Arena arena;
+		StringPool strings(arena);
+		for(Services::iterator s = services_.begin(); s != services_.end(); ++s) {
+			Service& service = s->second;
+			for(int i = 0; i < 2; ++i)
+				move(service.pf_[i], arena, strings);
+			for(Schedule::iterator i = service.schedule_.begin(); i != service.schedule_.end(); ++i)
+				move(i->second, arena, strings);
+		}
+		arena_.swap(arena);
+		strings_.swap(strings);
+		garbage_ = 0;
+	}
+
+	static void move(EpgEvent& e, Arena& arena, StringPool& strings) {
+		e.language_ = strings.intern(e.language_.data(), e.language_.size());
+		e.name_ = strings.intern(e.name_.data(), e.name_.size());
+		e.text_ = arena.copy(e.text_.data(), e.text_.size());
+		e.descriptors_ = arena.copy(e.descriptors_.data(), e.descriptors_.size());
+	}
+
+	Services services_;
+	Arena arena_;
+	StringPool strings_;
+	// bytes of arena_ no event refers to any more
+	size_t garbage_;
+	// reused from section to section
+	std::vector<EpgEvent> decoded_;
+	std::string text_;
+	LanguagePreference languages_;
+	EpgStats stats_;
+};
+
+#endif
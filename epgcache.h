@@ -0,0 +1,530 @@
+#ifndef _EPGCACHE_H_
+#define _EPGCACHE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "epg.h"
+
+// On-disk EPG schedule, used in place through mmap():
+//
+//   EpgCacheHeader
+//   EpgCacheService[services_]  sorted by key
+//   EpgTable[tables_]           receive state, tables of a service back to back
+//   EpgCacheEvent[events_]      events of a service back to back, by start time
+//   string pool                 names, texts and descriptor loops, each stored once
+//
+// All integers are in host byte order, the cache belongs to the box that
+// wrote it. A file with another magic, format version or byte order is not
+// used. Present/following tables are not kept, they are stale after a
+// restart anyway. Names and texts are in the languages preferred by the
+// run that wrote the cache, the header keeps that list.
+
+static const uint32_t EPG_CACHE_FORMAT = 2;
+static const uint32_t EPG_CACHE_BYTE_ORDER = 0x01020304;
+
+struct EpgCacheString {
+	uint32_t offset_;
+	uint32_t length_;
+};
+
+struct EpgCacheHeader {
+	char magic_[8];
+	uint32_t format_;
+	uint32_t byte_order_;
+	uint64_t size_;
+	// seconds since the epoch
+	int64_t written_;
+	uint32_t services_;
+	uint32_t tables_;
+	uint32_t events_;
+	uint32_t strings_size_;
+	uint64_t services_offset_;
+	uint64_t tables_offset_;
+	uint64_t events_offset_;
+	uint64_t strings_offset_;
+	// LanguagePreference::str() of the writer, in the string pool
+	EpgCacheString languages_;
+};
+
+struct EpgCacheService {
+	uint64_t key_;
+	uint32_t first_table_;
+	uint32_t tables_;
+	uint32_t first_event_;
+	uint32_t events_;
+	uint32_t longest_;
+	uint8_t last_table_[2];
+	uint8_t reserved_[2];
+};
+
+struct EpgCacheEvent {
+	int64_t start_;
+	uint32_t duration_;
+	uint16_t event_id_;
+	uint8_t running_status_;
+	uint8_t free_ca_mode_;
+	uint8_t table_id_;
+	uint8_t section_;
+	char language_[3];
+	uint8_t reserved_;
+	EpgCacheString name_;
+	EpgCacheString text_;
+	EpgCacheString descriptors_;
+};
+
+class EpgCache {
+public:
+	EpgCache() : base_(0), size_(0), header_(0), services_(0), tables_(0), events_(0), strings_(0) {}
+
+	~EpgCache() {
+		close();
+	}
+
+	// Maps the file, false if it is missing or not a usable cache
+	bool open(const char* path) {
+		close();
+
+		int fd = ::open(path, O_RDONLY);
+		if(fd < 0)
+			return false;
+
+		struct stat st;
+		if(fstat(fd, &st) < 0 || size_t(st.st_size) < sizeof(EpgCacheHeader)) {
+			::close(fd);
+			return false;
+		}
+
+		void* p = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if(p == MAP_FAILED)
+			return false;
+
+		base_ = static_cast<const uint8_t*>(p);
+		size_ = st.st_size;
+
+		if(!check()) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+		if(base_)
+			munmap(const_cast<uint8_t*>(base_), size_);
+		base_ = 0;
+		size_ = 0;
+		header_ = 0;
+	}
+
+	bool is_open() const { return base_ != 0; }
+
+	EpgCacheHeader const* header() const { return header_; }
+
+	// False if the events were chosen by another language preference; the
+	// cached names and texts would not follow this one
+	bool same_languages(LanguagePreference const& languages) const {
+		if(!header_)
+			return false;
+		ArenaString s = string(header_->languages_);
+		return languages.str() == std::string(s.data(), s.size());
+	}
+
+	size_t services() const { return header_ ? header_->services_ : 0; }
+	EpgCacheService const& service(size_t i) const { return services_[i]; }
+
+	EpgCacheService const* find(uint64_t key) const {
+		if(!header_)
+			return 0;
+		EpgCacheService const* end = services_ + header_->services_;
+		EpgCacheService const* i = std::lower_bound(services_, end, key, KeyLess());
+		return i != end && i->key_ == key ? i : 0;
+	}
+
+	EpgTable const* table(uint64_t key, uint8_t table_id) const {
+		EpgCacheService const* s = find(key);
+		return s ? table(*s, table_id) : 0;
+	}
+
+	EpgTable const* table(EpgCacheService const& s, uint8_t table_id) const {
+		for(uint32_t i = 0; i < s.tables_; ++i) {
+			if(tables_[s.first_table_ + i].table_id_ == table_id)
+				return &tables_[s.first_table_ + i];
+		}
+		return 0;
+	}
+
+	// True for an EIT schedule section the cache already holds, it would
+	// not change anything
+	bool known(EitSection const& eit) const {
+		EpgTable const* t = table(epg_service_key(eit.original_network_id(), eit.transport_stream_id(), eit.service_id()), eit.table_id());
+		return t && t->version_ == eit.version() && t->have(eit.section_number());
+	}
+
+	const EpgCacheEvent* begin(EpgCacheService const& s) const { return events_ + s.first_event_; }
+	const EpgCacheEvent* end(EpgCacheService const& s) const { return events_ + s.first_event_ + s.events_; }
+
+	// Events of a service overlapping [from, to), by start time
+	std::vector<EpgCacheEvent const*> events(uint64_t key, int64_t from, int64_t to) const {
+		std::vector<EpgCacheEvent const*> r;
+		EpgCacheService const* s = find(key);
+		if(!s)
+			return r;
+
+		int64_t first = from < INT64_MIN + int64_t(s->longest_) ? INT64_MIN : from - int64_t(s->longest_);
+		const EpgCacheEvent* i = std::lower_bound(begin(*s), end(*s), first, StartLess());
+		for(; i != end(*s) && i->start_ < to; ++i) {
+			if(i->start_ + int64_t(i->duration_) > from)
+				r.push_back(i);
+		}
+		return r;
+	}
+
+	bool now_next(uint64_t key, int64_t now, EpgCacheEvent const*& present, EpgCacheEvent const*& following) const {
+		present = following = 0;
+		EpgCacheService const* s = find(key);
+		if(!s)
+			return false;
+
+		const EpgCacheEvent* i = std::upper_bound(begin(*s), end(*s), now, StartLess());
+		if(i != begin(*s) && now < i[-1].start_ + int64_t(i[-1].duration_))
+			present = &i[-1];
+		if(i != end(*s))
+			following = i;
+		return present || following;
+	}
+
+	EpgProgress progress(uint64_t key) const {
+		EpgCacheService const* s = find(key);
+		if(!s) {
+			EpgProgress p = {0, 0};
+			return p;
+		}
+
+		EpgTable const* tables[32] = {0};
+		for(uint32_t i = 0; i < s->tables_; ++i) {
+			EpgTable const& t = tables_[s->first_table_ + i];
+			tables[t.table_id_ - 0x50] = &t;
+		}
+		return epg_progress(s->last_table_, tables);
+	}
+
+	// The bytes in the mapping, empty for a reference outside the pool
+	ArenaString string(EpgCacheString const& s) const {
+		if(s.offset_ > header_->strings_size_ || s.length_ > header_->strings_size_ - s.offset_)
+			return arena_string(0, 0);
+		return arena_string(strings_ + s.offset_, s.length_);
+	}
+
+	// In the form the in-memory database uses, its strings point into the
+	// mapping and are good until close()
+	EpgEvent event(EpgCacheEvent const& c) const {
+		EpgEvent e;
+		e.start_ = c.start_;
+		e.duration_ = c.duration_;
+		e.event_id_ = c.event_id_;
+		e.running_status_ = c.running_status_;
+		e.free_ca_mode_ = c.free_ca_mode_;
+		e.table_id_ = c.table_id_;
+		e.section_ = c.section_;
+		e.language_ = arena_string(c.language_, strnlen(c.language_, 3));
+		e.name_ = string(c.name_);
+		e.text_ = string(c.text_);
+		e.descriptors_ = string(c.descriptors_);
+		return e;
+	}
+
+	// Writes the schedule of 'epg' merged with 'old' to path through a
+	// temporary file and rename(). Tables the live database has in the same
+	// version as the old cache are merged, in another version the live one
+	// replaces the cached one, and tables only the cache has are copied. An
+	// old cache of another language preference is left out.
+	static bool write(const char* path, EpgDatabase const& epg, EpgCache const* old) {
+		if(old && !old->same_languages(epg.languages()))
+			old = 0;
+
+		Writer w;
+		w.languages(epg.languages());
+
+		std::vector<uint64_t> keys = epg.service_keys();
+		if(old) {
+			for(size_t i = 0; i < old->services(); ++i)
+				keys.push_back(old->service(i).key_);
+		}
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+		for(size_t i = 0; i < keys.size(); ++i)
+			w.add(keys[i], epg, old);
+
+		return w.write(path);
+	}
+
+private:
+	EpgCache(EpgCache const&);
+	EpgCache& operator = (EpgCache const&);
+
+	struct KeyLess {
+		bool operator () (EpgCacheService const& s, uint64_t key) const { return s.key_ < key; }
+	};
+
+	struct StartLess {
+		bool operator () (EpgCacheEvent const& e, int64_t t) const { return e.start_ < t; }
+		bool operator () (int64_t t, EpgCacheEvent const& e) const { return t < e.start_; }
+	};
+
+	template<typename T>
+	bool array(uint64_t offset, uint64_t count, const T*& p) const {
+		if(offset > size_ || count > (size_ - offset) / sizeof(T) || offset % 8)
+			return false;
+		p = reinterpret_cast<const T*>(base_ + offset);
+		return true;
+	}
+
+	bool check() {
+		EpgCacheHeader const* h = reinterpret_cast<EpgCacheHeader const*>(base_);
+		if(memcmp(h->magic_, "EPGCACHE", 8) || h->format_ != EPG_CACHE_FORMAT || h->byte_order_ != EPG_CACHE_BYTE_ORDER || h->size_ != size_)
+			return false;
+
+		if(!array(h->services_offset_, h->services_, services_) || !array(h->tables_offset_, h->tables_, tables_)
+			|| !array(h->events_offset_, h->events_, events_) || !array(h->strings_offset_, h->strings_size_, strings_))
+			return false;
+
+		for(uint32_t i = 0; i < h->services_; ++i) {
+			EpgCacheService const& s = services_[i];
+			if(s.first_table_ > h->tables_ || s.tables_ > h->tables_ - s.first_table_
+				|| s.first_event_ > h->events_ || s.events_ > h->events_ - s.first_event_)
+				return false;
+			for(uint32_t j = 0; j < s.tables_; ++j) {
+				if(tables_[s.first_table_ + j].table_id_ < 0x50 || tables_[s.first_table_ + j].table_id_ > 0x6F)
+					return false;
+			}
+		}
+
+		header_ = h;
+		return true;
+	}
+
+	// Builds the sections of a new cache file in memory
+	class Writer {
+	public:
+		Writer() {
+			languages_.offset_ = languages_.length_ = 0;
+		}
+
+		void add(uint64_t key, EpgDatabase const& epg, EpgCache const* old) {
+			EpgCacheService s;
+			memset(&s, 0, sizeof(s));
+			s.key_ = key;
+			s.first_table_ = tables_.size();
+			s.first_event_ = events_.size();
+
+			EpgCacheService const* cached = old ? old->find(key) : 0;
+			EpgDatabase::Schedule const* schedule = epg.schedule(key);
+
+			for(int other = 0; other < 2; ++other) {
+				s.last_table_[other] = epg.last_table(key, other);
+				if(!s.last_table_[other] && cached)
+					s.last_table_[other] = cached->last_table_[other];
+			}
+
+			// events of each table, live first so they win over cached ones with the same key
+			std::vector<EpgCacheEvent> events;
+			for(uint8_t tid = 0x50; tid <= 0x6F; ++tid) {
+				EpgTable const* live = epg.table(key, tid);
+				if(live && !live->known())
+					live = 0;
+				EpgTable const* disk = cached ? old->table(*cached, tid) : 0;
+
+				if(!live && !disk)
+					continue;
+
+				EpgTable t = live ? *live : *disk;
+				bool use_disk = disk && (!live || live->version_ == disk->version_);
+				if(live && use_disk) {
+					for(size_t i = 0; i < sizeof(t.have_); ++i)
+						t.have_[i] |= disk->have_[i];
+					for(size_t i = 0; i < sizeof(t.segment_last_); ++i)
+						t.segment_last_[i] = std::max(t.segment_last_[i], disk->segment_last_[i]);
+				}
+				tables_.push_back(t);
+
+				if(live && schedule) {
+					for(EpgDatabase::Schedule::const_iterator i = schedule->begin(); i != schedule->end(); ++i) {
+						if(i->second.table_id_ == tid)
+							events.push_back(record(i->second));
+					}
+				}
+				if(use_disk) {
+					for(const EpgCacheEvent* i = old->begin(*cached); i != old->end(*cached); ++i) {
+						if(i->table_id_ == tid)
+							events.push_back(copy(*i, *old));
+					}
+				}
+			}
+
+			std::stable_sort(events.begin(), events.end(), EventLess());
+			for(size_t i = 0; i < events.size(); ++i) {
+				if(i && events[i].start_ == events[i - 1].start_ && events[i].event_id_ == events[i - 1].event_id_)
+					continue;
+				s.longest_ = std::max(s.longest_, events[i].duration_);
+				events_.push_back(events[i]);
+			}
+
+			s.tables_ = tables_.size() - s.first_table_;
+			s.events_ = events_.size() - s.first_event_;
+			if(s.tables_ || s.events_)
+				services_.push_back(s);
+		}
+
+		void languages(LanguagePreference const& languages) {
+			std::string s = languages.str();
+			languages_ = intern(s.data(), s.size());
+		}
+
+		bool write(const char* path) {
+			EpgCacheHeader h;
+			memset(&h, 0, sizeof(h));
+			memcpy(h.magic_, "EPGCACHE", 8);
+			h.format_ = EPG_CACHE_FORMAT;
+			h.byte_order_ = EPG_CACHE_BYTE_ORDER;
+			h.written_ = time(0);
+			h.services_ = services_.size();
+			h.tables_ = tables_.size();
+			h.events_ = events_.size();
+			h.strings_size_ = strings_.size();
+			h.languages_ = languages_;
+			h.services_offset_ = align(sizeof(h));
+			h.tables_offset_ = align(h.services_offset_ + services_.size() * sizeof(EpgCacheService));
+			h.events_offset_ = align(h.tables_offset_ + tables_.size() * sizeof(EpgTable));
+			h.strings_offset_ = align(h.events_offset_ + events_.size() * sizeof(EpgCacheEvent));
+			h.size_ = h.strings_offset_ + strings_.size();
+
+			std::vector<uint8_t> file(h.size_);
+			memcpy(&file[0], &h, sizeof(h));
+			if(!services_.empty())
+				memcpy(&file[h.services_offset_], &services_[0], services_.size() * sizeof(EpgCacheService));
+			if(!tables_.empty())
+				memcpy(&file[h.tables_offset_], &tables_[0], tables_.size() * sizeof(EpgTable));
+			if(!events_.empty())
+				memcpy(&file[h.events_offset_], &events_[0], events_.size() * sizeof(EpgCacheEvent));
+			if(!strings_.empty())
+				memcpy(&file[h.strings_offset_], &strings_[0], strings_.size());
+
+			std::string tmp = std::string(path) + ".tmp";
+			int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if(fd < 0)
+				return false;
+
+			size_t done = 0;
+			while(done < file.size()) {
+				ssize_t r = ::write(fd, &file[done], file.size() - done);
+				if(r < 0 && errno == EINTR)
+					continue;
+				if(r <= 0)
+					break;
+				done += r;
+			}
+
+			bool ok = done == file.size() && fsync(fd) == 0;
+			ok = ::close(fd) == 0 && ok;
+			if(!ok || rename(tmp.c_str(), path) < 0) {
+				unlink(tmp.c_str());
+				return false;
+			}
+			return true;
+		}
+
+	private:
+		struct EventLess {
+			bool operator () (EpgCacheEvent const& a, EpgCacheEvent const& b) const {
+				return a.start_ < b.start_ || (a.start_ == b.start_ && a.event_id_ < b.event_id_);
+			}
+		};
+
+		static uint64_t align(uint64_t n) {
+			return (n + 7) & ~uint64_t(7);
+		}
+
+		EpgCacheString intern(const void* p, size_t n) {
+			EpgCacheString s = {0, 0};
+			if(!n)
+				return s;
+
+			std::string key(static_cast<const char*>(p), n);
+			std::unordered_map<std::string, uint32_t>::const_iterator i = pool_.find(key);
+			if(i != pool_.end())
+				s.offset_ = i->second;
+			else {
+				s.offset_ = strings_.size();
+				strings_.insert(strings_.end(), key.begin(), key.end());
+				pool_[key] = s.offset_;
+			}
+			s.length_ = n;
+			return s;
+		}
+
+		EpgCacheEvent header(int64_t start, uint32_t duration, uint16_t event_id, uint8_t running_status,
+			bool free_ca_mode, uint8_t table_id, uint8_t section, const char* language, size_t language_length) {
+			EpgCacheEvent c;
+			memset(&c, 0, sizeof(c));
+			c.start_ = start;
+			c.duration_ = duration;
+			c.event_id_ = event_id;
+			c.running_status_ = running_status;
+			c.free_ca_mode_ = free_ca_mode;
+			c.table_id_ = table_id;
+			c.section_ = section;
+			memcpy(c.language_, language, std::min<size_t>(language_length, 3));
+			return c;
+		}
+
+		EpgCacheEvent record(EpgEvent const& e) {
+			EpgCacheEvent c = header(e.start_, e.duration_, e.event_id_, e.running_status_, e.free_ca_mode_,
+				e.table_id_, e.section_, e.language_.data(), e.language_.size());
+			c.name_ = intern(e.name_.data(), e.name_.size());
+			c.text_ = intern(e.text_.data(), e.text_.size());
+			c.descriptors_ = intern(e.descriptors_.data(), e.descriptors_.size());
+			return c;
+		}
+
+		EpgCacheEvent copy(EpgCacheEvent const& e, EpgCache const& old) {
+			EpgCacheEvent c = e;
+			ArenaString name = old.string(e.name_), text = old.string(e.text_), descriptors = old.string(e.descriptors_);
+			c.name_ = intern(name.data(), name.size());
+			c.text_ = intern(text.data(), text.size());
+			c.descriptors_ = intern(descriptors.data(), descriptors.size());
+			return c;
+		}
+
+		std::vector<EpgCacheService> services_;
+		std::vector<EpgTable> tables_;
+		std::vector<EpgCacheEvent> events_;
+		std::vector<uint8_t> strings_;
+		std::unordered_map<std::string, uint32_t> pool_;
+		EpgCacheString languages_;
+	};
+
+	const uint8_t* base_;
+	size_t size_;
+	EpgCacheHeader const* header_;
+	const EpgCacheService* services_;
+	const EpgTable* tables_;
+	const EpgCacheEvent* events_;
+	const uint8_t* strings_;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#include "fuzz.h"
+
+// Once with every event descriptor, once with those parse-eit -l deu,eng keeps
+template<class Out>
+struct Eit : AllDescriptors<Out> {
+	Eit() {
+		languages_.parse("deu,eng");
+		add_all_descriptors(preferred_);
+		preferred_.set_languages(&languages_);
+	}
+
+	void operator () (Out& os, ByteView v) {
+		write_eit(os, EitSection(v), this->descriptors_);
+		write_eit(os, EitSection(v), preferred_);
+	}
+
+	LanguagePreference languages_;
+	DescriptorRegistry<Out> preferred_;
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	return fuzz_section<Eit>(data, size);
+}
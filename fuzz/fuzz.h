@@ -0,0 +1,72 @@
+#ifndef _FUZZ_H_
+#define _FUZZ_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <exception>
+#include <vector>
+
+#include "section.h"
+#include "json.h"
+#include "record.h"
+#include "descriptors.h"
+#include "tables.h"
+
+// libFuzzer harnesses for the table writers of tables.h, one per table,
+// each input one section. The seeds in fuzz/corpus/<table> cover every
+// descriptor some tool decodes:
+//
+//	make fuzz
+//	./fuzz-eit -max_len=4096 fuzz/corpus/eit
+//
+// A compiler without libFuzzer builds the same harnesses with replay.cpp,
+// which runs them once over the files given, e.g. the corpus or a crash:
+//
+//	make fuzz FUZZ_CXX=g++ FUZZ_FLAGS="-g -fsanitize=address,undefined" FUZZ_MAIN=fuzz/replay.cpp
+//	./fuzz-eit fuzz/corpus/eit/*
+
+// Writes the section with Table<JsonRecord> and Table<BinaryRecord>,
+// functors called as table(os, view). A broken section has to end in an
+// exception, anything else the sanitizers see is a bug.
+template<template<class> class Table>
+int fuzz_section(const uint8_t* data, size_t size) {
+	static JsonWriter out(-1);
+	static Table<JsonRecord> json;
+	static Table<BinaryRecord> binary;
+
+	if(!size)
+		return 0;
+	// a heap block of the exact size, so ASan sees every read past the end
+	std::vector<uint8_t> s(data, data + size);
+	ByteView v(&s[0], s.size());
+
+	try {
+		JsonRecord os(out);
+		json(os, v);
+	}
+	catch(std::exception const&) {
+	}
+	out.truncate(0);
+
+	try {
+		BinaryRecord os(out);
+		binary(os, v);
+	}
+	catch(std::exception const&) {
+	}
+	out.truncate(0);
+	return 0;
+}
+
+// The writers of the tables with descriptors, with every descriptor
+template<class Out>
+struct AllDescriptors {
+	AllDescriptors() {
+		add_all_descriptors(descriptors_);
+	}
+
+	DescriptorRegistry<Out> descriptors_;
+};
+
+#endif
@@ -0,0 +1,12 @@
+#include "fuzz.h"
+
+template<class Out>
+struct Pat {
+	void operator () (Out& os, ByteView v) {
+		write_pat(os, PatSection(v));
+	}
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	return fuzz_section<Pat>(data, size);
+}
@@ -0,0 +1,12 @@
+#include "fuzz.h"
+
+template<class Out>
+struct Pmt : AllDescriptors<Out> {
+	void operator () (Out& os, ByteView v) {
+		write_pmt(os, PmtSection(v), this->descriptors_);
+	}
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	return fuzz_section<Pmt>(data, size);
+}
@@ -0,0 +1,32 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+// main() for building the harnesses without libFuzzer: runs each file
+// given once, so a corpus or a crash found elsewhere can be checked with
+// any compiler's sanitizers
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+int main(int argc, char* argv[]) {
+	std::vector<uint8_t> buf;
+	for(int i = 1; i < argc; ++i) {
+		FILE* f = fopen(argv[i], "rb");
+		if(!f) {
+			perror(argv[i]);
+			return 1;
+		}
+		buf.clear();
+		uint8_t b[4096];
+		size_t n;
+		while((n = fread(b, 1, sizeof(b), f)) > 0)
+			buf.insert(buf.end(), b, b + n);
+		fclose(f);
+
+		LLVMFuzzerTestOneInput(buf.empty() ? 0 : &buf[0], buf.size());
+	}
+	fprintf(stderr, "replay: %d inputs\n", argc - 1);
+	return 0;
+}
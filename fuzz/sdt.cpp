@@ -0,0 +1,12 @@
+#include "fuzz.h"
+
+template<class Out>
+struct Sdt : AllDescriptors<Out> {
+	void operator () (Out& os, ByteView v) {
+		write_sdt(os, SdtSection(v), this->descriptors_);
+	}
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	return fuzz_section<Sdt>(data, size);
+}
@@ -0,0 +1,276 @@
+#ifndef _JSON_H_
+#define _JSON_H_
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Escaped string contents, the surrounding quotes are written by the caller.
+// 'strict' also escapes '"', '\\' and '/', otherwise only control characters
+// are escaped (what parse-sdt has always printed).
+struct JsonString {
+	const char* s_;
+	size_t n_;
+	bool strict_;
+};
+
+inline JsonString json_string(const char* s, size_t n, bool strict = true) {
+	JsonString j = {s, n, strict};
+	return j;
+}
+
+inline JsonString json_string(std::string const& s, bool strict = true) {
+	return json_string(s.data(), s.size(), strict);
+}
+
+// Lowercase hexadecimal without prefix, like std::hex
+struct JsonHex {
+	uint64_t v_;
+};
+
+inline JsonHex json_hex(uint64_t v) {
+	JsonHex j = {v};
+	return j;
+}
+
+// Decimal padded with zeros to 'width' digits
+struct JsonPadded {
+	uint64_t v_;
+	int width_;
+};
+
+inline JsonPadded json_padded(uint64_t v, int width) {
+	JsonPadded j = {v, width};
+	return j;
+}
+
+// Append-only text buffer for JSON output. Formatting never touches the
+// locale and strings are checked for characters to escape 8 bytes at a
+// time. Nothing is written to the file descriptor until flush(), so a
+// record that fails halfway can be dropped with truncate().
+class JsonWriter {
+public:
+	JsonWriter(int fd = STDOUT_FILENO, size_t flush_size = 256*1024)
+		: fd_(fd), flush_size_(flush_size), buf_(flush_size + 4096), len_(0), failed_(false) {}
+
+	~JsonWriter() {
+		flush();
+	}
+
+	JsonWriter& operator << (char c) {
+		reserve(1)[0] = c;
+		++len_;
+		return *this;
+	}
+
+	JsonWriter& operator << (const char* s) {
+		return append(s, strlen(s));
+	}
+
+	JsonWriter& operator << (std::string const& s) {
+		return append(s.data(), s.size());
+	}
+
+	JsonWriter& operator << (bool v) { return *this << (v ? '1' : '0'); }
+	JsonWriter& operator << (int v) { return number(v); }
+	JsonWriter& operator << (long v) { return number(v); }
+	JsonWriter& operator << (long long v) { return number(v); }
+	JsonWriter& operator << (unsigned int v) { return number(v, false); }
+	JsonWriter& operator << (unsigned long v) { return number(v, false); }
+	JsonWriter& operator << (unsigned long long v) { return number(v, false); }
+
+	JsonWriter& operator << (JsonHex h) {
+		char tmp[16];
+		char* e = tmp + sizeof(tmp);
+		char* p = e;
+		uint64_t v = h.v_;
+		do {
+			*--p = "0123456789abcdef"[v & 0xF];
+			v >>= 4;
+		} while(v);
+		return append(p, e - p);
+	}
+
+	JsonWriter& operator << (JsonPadded d) {
+		char tmp[24];
+		char* e = tmp + sizeof(tmp);
+		char* p = format(d.v_, e);
+		while(e - p < d.width_ && p > tmp)
+			*--p = '0';
+		return append(p, e - p);
+	}
+
+	JsonWriter& operator << (JsonString const& j) {
+		// worst case every byte becomes \u00XX
+		char* out = reserve(j.n_ * 6);
+		char* o = out;
+		const uint8_t* s = reinterpret_cast<const uint8_t*>(j.s_);
+		size_t n = j.n_;
+
+		for(; n >= 8; s += 8, n -= 8) {
+			uint64_t w;
+			memcpy(&w, s, 8);
+			if(!special(w, j.strict_)) {
+				memcpy(o, s, 8);
+				o += 8;
+				continue;
+			}
+			for(size_t i = 0; i < 8; ++i)
+				o = escape(s[i], j.strict_, o);
+		}
+		for(; n; ++s, --n)
+			o = escape(*s, j.strict_, o);
+
+		len_ += o - out;
+		return *this;
+	}
+
+	JsonWriter& append(const char* s, size_t n) {
+		memcpy(reserve(n), s, n);
+		len_ += n;
+		return *this;
+	}
+
+	size_t size() const { return len_; }
+	const char* data() const { return &buf_[0]; }
+
+	// What has been appended since size() returned 'from'
+	std::string str(size_t from = 0) const {
+		return from < len_ ? std::string(&buf_[from], len_ - from) : std::string();
+	}
+
+	// Drops everything appended after size() returned n
+	void truncate(size_t n) {
+		if(n < len_)
+			len_ = n;
+	}
+
+	// false once a write to the file descriptor has failed
+	bool good() const { return !failed_; }
+
+	// Writes the buffer out, unless 'force' is false and it holds less
+	// than flush_size bytes. A writer on fd -1 only collects text for str().
+	bool flush(bool force = true) {
+		if(fd_ < 0 || (!force && len_ < flush_size_))
+			return !failed_;
+
+		size_t done = 0;
+		while(done < len_ && !failed_) {
+			ssize_t r = ::write(fd_, &buf_[done], len_ - done);
+			if(r < 0) {
+				if(errno == EINTR) continue;
+				failed_ = true;
+				break;
+			}
+			done += r;
+		}
+		len_ = 0;
+		return !failed_;
+	}
+
+private:
+	JsonWriter(JsonWriter const&);
+	JsonWriter& operator = (JsonWriter const&);
+
+	// Room for n more bytes at the end of the buffer
+	char* reserve(size_t n) {
+		if(buf_.size() - len_ < n)
+			buf_.resize(std::max(buf_.size() * 2, len_ + n));
+		return &buf_[len_];
+	}
+
+	JsonWriter& number(long long v) {
+		if(v >= 0)
+			return number(v, false);
+		char tmp[24];
+		char* e = tmp + sizeof(tmp);
+		char* p = format(0 - (unsigned long long)v, e);
+		*--p = '-';
+		return append(p, e - p);
+	}
+
+	JsonWriter& number(unsigned long long v, bool) {
+		char tmp[24];
+		char* e = tmp + sizeof(tmp);
+		char* p = format(v, e);
+		return append(p, e - p);
+	}
+
+	// Decimal digits of v ending at e, two at a time; returns the first one
+	static char* format(uint64_t v, char* e) {
+		static const char pairs[] =
+			"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+			"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+			"8081828384858687888990919293949596979899";
+		char* p = e;
+		while(v >= 100) {
+			const char* d = pairs + (v % 100) * 2;
+			v /= 100;
+			*--p = d[1];
+			*--p = d[0];
+		}
+		if(v >= 10) {
+			const char* d = pairs + v * 2;
+			*--p = d[1];
+			*--p = d[0];
+		}
+		else
+			*--p = '0' + v;
+		return p;
+	}
+
+	// True if any of the 8 bytes in w may need escaping
+	static bool special(uint64_t w, bool strict) {
+		const uint64_t ones = 0x0101010101010101ull;
+		const uint64_t highs = ones * 0x80;
+		uint64_t m = (w - ones * 0x20) & ~w & highs; // bytes below 0x20
+		if(strict)
+			m |= zero(w ^ (ones * '"')) | zero(w ^ (ones * '\\')) | zero(w ^ (ones * '/'));
+		return m != 0;
+	}
+
+	static uint64_t zero(uint64_t w) {
+		const uint64_t ones = 0x0101010101010101ull;
+		return (w - ones) & ~w & (ones * 0x80);
+	}
+
+	// NUL and bytes from 0x80 up are copied as they are
+	static char* escape(uint8_t c, bool strict, char* o) {
+		if(c > 0 && c < 32) {
+			*o++ = '\\';
+			switch(c) {
+			case '\b': *o++ = 'b'; break;
+			case '\n': *o++ = 'n'; break;
+			case '\r': *o++ = 'r'; break;
+			case '\t': *o++ = 't'; break;
+			default:
+				*o++ = 'u';
+				*o++ = '0';
+				*o++ = '0';
+				*o++ = "0123456789abcdef"[c >> 4];
+				*o++ = "0123456789abcdef"[c & 0xF];
+				break;
+			}
+		}
+		else if(strict && (c == '"' || c == '\\' || c == '/')) {
+			*o++ = '\\';
+			*o++ = c;
+		}
+		else
+			*o++ = c;
+		return o;
+	}
+
+	int fd_;
+	size_t flush_size_;
+	std::vector<char> buf_;
+	size_t len_;
+	bool failed_;
+};
+
+#endif
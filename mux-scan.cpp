@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "ts.h"
+#include "tsscan.h"
+#include "psi.h"
+#include "json.h"
+#include "record.h"
+#include "descriptors.h"
+#include "servicescan.h"
+#include "demuxscan.h"
+
+static volatile sig_atomic_t g_stop = 0;
+
+void sighandler(int n) {
+	g_stop = 1;
+}
+
+void usage() {
+	fprintf(stderr, "usage: mux-scan [-b] [-t seconds] device_name\n"
+		"       mux-scan [-b] [-t seconds] -f file|-\n"
+		"\tcollects PAT, every PMT, SDT actual and NIT actual of one multiplex at once\n"
+		"\tand writes the service map when all of them are complete or on timeout\n"
+		"\t-f\tread a transport stream instead of a demux device, times are stream times by PCR\n"
+		"\t-b\tbinary record instead of JSON, see record.h\n"
+		"\t-t\tgive up on missing tables after this many seconds, default 30\n");
+	exit(1);
+}
+
+// Hands the sections of the PIDs the scan wants to it, with the time
+// since the first PCR of the stream
+struct TsScanner {
+	TsScanner(ServiceScan& scan) : scan_(scan), pcr_pid_(-1), pcr0_(0), now_(0) {
+		update();
+	}
+
+	void operator () (int pid, const uint8_t* s, size_t n) {
+		if(scan_.add(pid, s, n, now_))
+			update();
+	}
+
+	// A packet, false once the scan is complete
+	bool operator () (const uint8_t* p) {
+		clock(p);
+		demux_.push(p, *this);
+		return !scan_.complete();
+	}
+
+	void clock(const uint8_t* p) {
+		uint64_t pcr;
+		if(!ts_pcr(p, &pcr))
+			return;
+		if(pcr_pid_ < 0) {
+			pcr_pid_ = ts_pid(p);
+			pcr0_ = pcr;
+		}
+		if(ts_pid(p) == pcr_pid_)
+			now_ = std::max<int64_t>(ts_pcr_diff(pcr0_, pcr), 0) * 1000000 / TS_PCR_HZ;
+	}
+
+	// PIDs once wanted stay in the demux, their sections are ignored
+	void update() {
+		std::vector<ScanFilter> f = scan_.filters();
+		for(size_t i = 0; i < f.size(); ++i)
+			demux_.add_pid(f[i].pid_);
+	}
+
+	ServiceScan& scan_;
+	SectionDemux demux_;
+	int pcr_pid_;
+	uint64_t pcr0_;
+	uint64_t now_;
+};
+
+int scan_ts(const char* path, ServiceScan& scan, uint64_t timeout) {
+	int fd = STDIN_FILENO;
+	if(strcmp(path, "-") != 0) {
+		fd = open(path, O_RDONLY);
+		if(fd < 0) {
+			perror("open");
+			return 1;
+		}
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+
+	TsScanner ts(scan);
+	std::vector<uint8_t> buf(TS_PACKET_SIZE * 4096);
+	size_t fill = 0;
+	PacketScanner scanner;
+
+	while(!g_stop && !scan.complete() && ts.now_ < timeout) {
+		ssize_t r = read(fd, &buf[fill], buf.size() - fill);
+		if(r < 0) {
+			if(errno == EINTR) continue;
+			perror("read");
+			return 1;
+		}
+		if(r == 0)
+			break;
+		fill += r;
+
+		size_t off = scanner.scan(&buf[0], fill, ts);
+		memmove(&buf[0], &buf[off], fill - off);
+		fill -= off;
+	}
+
+	if(fd != STDIN_FILENO)
+		close(fd);
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	const char* file = 0;
+	bool binary = false;
+	uint64_t timeout = 30;
+
+	int opt;
+	while((opt = getopt(argc, argv, "f:bt:")) != -1) {
+		switch(opt) {
+		case 'f': file = optarg; break;
+		case 'b': binary = true; break;
+		case 't': timeout = atoi(optarg); break;
+		default: usage();
+		}
+	}
+
+	if(argc - optind != (file ? 0 : 1))
+		usage();
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sighandler;
+	sigaction(SIGTERM, &sa, 0);
+	sigaction(SIGINT, &sa, 0);
+
+	ServiceScan scan;
+	int r = file ? scan_ts(file, scan, timeout * 1000000) : scan_demux(argv[optind], scan, timeout * 1000000, g_stop);
+	if(r != 0)
+		return r;
+
+	JsonWriter out;
+	try {
+		if(binary) {
+			BinaryRecord rec(out);
+			DescriptorRegistry<BinaryRecord> descriptors;
+			add_scan_descriptors(descriptors);
+			scan.write(rec, descriptors);
+		}
+		else {
+			JsonRecord rec(out);
+			DescriptorRegistry<JsonRecord> descriptors;
+			add_scan_descriptors(descriptors);
+			scan.write(rec, descriptors);
+			out << '\n';
+		}
+	}
+	catch(std::exception const& e) {
+		out.truncate(0);
+		fprintf(stderr, "mux-scan: %s\n", e.what());
+		return 1;
+	}
+	out.flush();
+
+	if(scan.complete())
+		fprintf(stderr, "mux-scan: complete\n");
+	else
+		fprintf(stderr, "mux-scan: incomplete: %s\n", scan.missing().c_str());
+	if(scan.invalid())
+		fprintf(stderr, "mux-scan: %llu invalid sections\n", (unsigned long long)scan.invalid());
+
+	return scan.complete() ? 0 : 2;
+}
@@ -1,133 +1,61 @@
 #include <stdio.h>
-#include <iostream>
-#include <arpa/inet.h>
-
-uint32_t ntoh(uint32_t t) {
-	return ntohl(t);
-}
-
-uint16_t ntoh(uint16_t t) {
-	return ntohs(t);
-}
-
-uint8_t ntoh(uint8_t t) {
-	return t;
-}
-
-template<typename T>
-struct ReadWrapper {
-	ReadWrapper(T& t) : t_(t) {}
-	T& t_;
-};
-
-template<typename T>
-std::istream& operator >> (std::istream& is, ReadWrapper<T> const& r) {
-	is.read(reinterpret_cast<char*>(&r.t_), sizeof(r.t_));
-	r.t_ = ntoh(r.t_);
-	return is;
-}
+#include <string>
+
+#include "section.h"
+#include "json.h"
+#include "record.h"
+#include "tables.h"
+#include "descriptors.h"
+#include "secdiff.h"
+
+// Streams keyed by elementary_PID
+bool diff_pmt(JsonWriter& os, TableDiff& diff, PmtSection const& pmt, DescriptorRegistry<JsonRecord> const& descriptors) {
+	JsonWriter js(-1, 4096);
+	TableSnapshot t;
+	t.version_ = pmt.version();
+	std::string buf;
+
+	JsonRecord header(js);
+	header.number("pcrpid", pmt.pcr_pid());
+	descriptors.write(header, pmt.descriptors(), buf);
+	t.header_.json_ = js.str();
+	t.header_.descriptors_ = raw_descriptors(pmt.descriptors());
+
+	Loop<PmtStream> streams = pmt.streams();
+	for(Loop<PmtStream>::iterator i = streams.begin(); i != streams.end(); ++i) {
+		PmtStream es = *i;
+		js.truncate(0);
+		JsonRecord r(js);
+		write_stream(r, es, descriptors, buf);
+		TableItem& item = t.items_[es.pid()];
+		item.json_ = js.str();
+		item.descriptors_ = raw_descriptors(es.descriptors());
+	}
 
-template<typename T>
-ReadWrapper<T> read(T& t) {
-	return ReadWrapper<T>(t);
+	js.truncate(0);
+	js << "\"program_number\":" << pmt.program_number();
+	return diff.update(os, "pmt", pmt.program_number(), js.str(), t);
 }
 
-struct PmtSectionHeader {
-	uint8_t tableid_;
-	uint16_t length_;
+template<class Out>
+struct Pmt {
+	Pmt() {
+		add_pmt_descriptors(descriptors_);
+	}
 
-	static const size_t header_length = 9;
+	static bool wanted(uint8_t table_id) { return table_id == 0x02; }
 
-	uint16_t program_number_;
-	
-	uint8_t version_;
-	bool current_next_;
+	void write(Out& os, PmtSection const& pmt) {
+		write_pmt(os, pmt, descriptors_);
+	}
 
-	uint8_t section_number_;
-	uint8_t last_section_number_;
+	bool diff(JsonWriter& os, TableDiff& diff, PmtSection const& pmt) {
+		return diff_pmt(os, diff, pmt, descriptors_);
+	}
 
-	uint16_t pcr_pid_;
-	uint16_t program_info_length_;
+	DescriptorRegistry<Out> descriptors_;
 };
 
-std::istream& operator >> (std::istream& is, PmtSectionHeader& h) {
-	uint16_t d;
-	uint8_t v;
-	is >> read(h.tableid_) >> read(d) >> read(h.program_number_) >> read(v) >> read(h.section_number_)
-		>> read(h.last_section_number_) >> read(h.pcr_pid_) >> read(h.program_info_length_);
-
-	h.length_ = d & ((1 << 12) - 1);
-	h.version_ = (v & ((1 << 5) -1)) >> 1;
-	h.current_next_ = v & 1;
-	h.pcr_pid_ &= ((1 << 12) - 1);
-	h.program_info_length_ &= ((1 << 9) - 1);
-
-	return is;
-}
-
 int main(int argc, char* argv[]) {
-	std::cin.rdbuf()->pubsetbuf(0,0);
-
-	PmtSectionHeader hdr = {0};
- 		
-	if(std::cin >> hdr) {
-		std::cout << "{";		
-
-		std::cout << "\"tableid\":" << (uint32_t)hdr.tableid_ << ",";
-		std::cout << "\"program_number\":" << hdr.program_number_ << ",";
-		std::cout << "\"version\":" << (uint32_t)hdr.version_ << ",";
-		std::cout << "\"number\":" << (uint32_t)hdr.section_number_ << ",";
-		std::cout << "\"lastnumber\":" << (uint32_t)hdr.last_section_number_ << ",";
-		std::cout << "\"pcrpid\":" << hdr.pcr_pid_ << ",";
-
-		std::cout << "\"descriptors\":[";
-		for(size_t count = 0; count != hdr.program_info_length_;) {
-			if(count) std::cout << ",";
-
-			uint8_t tag;
-			uint8_t length;
-			std::cin >> read(tag) >> read(length);
-			std::cin.ignore(length);
-
-			std::cout << "{\"tag\":" << (uint32_t)tag << "}";
-
-			count += sizeof(tag) + sizeof(length) + length;
-		}
-
-		std::cout << "], \"streams\": [";
-		for(size_t count = 0; count != hdr.length_ - PmtSectionHeader::header_length - hdr.program_info_length_ - sizeof(uint32_t);) {
-			if(count) std::cout << ',';	
-			
-			uint8_t type;
-			uint16_t pid;
-			uint16_t len;
-			
-			std::cin >> read(type) >> read(pid) >> read(len);
-			pid &= ((1 << 13)-1);
-			len &= ((1 << 10)-1);
-
-			count += sizeof(type) + sizeof(pid) + sizeof(len) + len;
-	
-			std::cout << "{" << "\"type\":" << (uint32_t)type << ",\"pid\":" << pid << ",\"descriptors\":[";
-			for(size_t count = 0; count < len;) {
-				if(count) std::cout << ",";
-
-				uint8_t tag;
-       	uint8_t length;
-       	std::cin >> read(tag) >> read(length);
-				std::cin.ignore(length);
-				count += sizeof(tag) + sizeof(length) + length;				
-	
-				std::cout << "{\"tag\":" << (uint32_t)tag << "}";	
-			}
-			std::cout << "]}";
-		}
-		std::cout << "]";
-
-		uint32_t crc;
-		std::cin >> read(crc);
-
-		std::cout << "}" << std::endl;	
-	}
+	return parse_table<PmtSection, Pmt>(argc, argv, "parse-pmt");
 }
-
@@ -0,0 +1,232 @@
+#ifndef _PSI_H_
+#define _PSI_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "ts.h"
+#include "crc32.h"
+
+static const size_t PSI_MAX_SECTION = 4096;
+
+struct SectionAssemblerStats {
+	uint64_t sections_;
+	uint64_t bytes_;
+	uint64_t crc_errors_;
+	uint64_t cc_errors_;
+	uint64_t duplicates_;
+	// partial sections thrown away (bad pointer_field, length, or loss)
+	uint64_t dropped_;
+};
+
+// True if the section carries a CRC_32: every long form section and the TOT
+inline bool psi_has_crc(const uint8_t* s, size_t n) {
+	return n >= 3 && ((s[1] & 0x80) || s[0] == 0x73);
+}
+
+// Reassembles the sections of one PID from its TS packets. Sections that
+// fit in one packet are handed out straight from the packet, the others
+// are collected in an internal buffer. CC errors discard the section in
+// progress, and so does a section that is not finished when the next
+// pointer_field says a new one starts.
+class SectionAssembler {
+public:
+	SectionAssembler(bool check_crc = true) : cc_(-1), check_crc_(check_crc), stats_() {
+		buf_.reserve(PSI_MAX_SECTION);
+	}
+
+	// Calls f(section, length) for every complete section
+	template<typename F>
+	void push(const uint8_t* p, F& f) {
+		if(ts_tei(p)) {
+			reset();
+			return;
+		}
+
+		size_t n;
+		const uint8_t* d = ts_payload(p, &n);
+		if(!d)
+			return;
+
+		int cc = ts_cc(p);
+		if(cc_ >= 0 && !ts_discontinuity(p)) {
+			if(cc == cc_) {
+				++stats_.duplicates_;
+				return;
+			}
+			if(cc != ((cc_ + 1) & 0xF)) {
+				++stats_.cc_errors_;
+				reset();
+			}
+		}
+		cc_ = cc;
+
+		if(ts_pusi(p)) {
+			size_t pointer = d[0];
+			++d;
+			--n;
+			if(pointer > n) {
+				++stats_.dropped_;
+				buf_.clear();
+				return;
+			}
+
+			if(!buf_.empty()) {
+				append(d, pointer, f);
+				if(!buf_.empty()) {
+					++stats_.dropped_;
+					buf_.clear();
+				}
+			}
+
+			d += pointer;
+			n -= pointer;
+
+			while(n && d[0] != 0xFF) {
+				size_t used = append(d, n, f);
+				d += used;
+				n -= used;
+				if(!buf_.empty())
+					break;
+			}
+		}
+		else if(!buf_.empty())
+			append(d, n, f); // whatever follows the end of the section is stuffing
+	}
+
+	void reset() {
+		if(!buf_.empty())
+			++stats_.dropped_;
+		buf_.clear();
+	}
+
+	SectionAssemblerStats const& stats() const { return stats_; }
+
+private:
+	// Consumes bytes of the current section, returns how many were used
+	template<typename F>
+	size_t append(const uint8_t* d, size_t n, F& f) {
+		if(buf_.empty() && n >= 3) {
+			size_t need = 3 + (((d[1] & 0x0F) << 8) | d[2]);
+			if(need <= n) {
+				emit(d, need, f);
+				return need;
+			}
+		}
+
+		size_t used = 0;
+		if(buf_.size() < 3) {
+			used = std::min(3 - buf_.size(), n);
+			buf_.insert(buf_.end(), d, d + used);
+			if(buf_.size() < 3)
+				return used;
+		}
+
+		size_t need = 3 + (((buf_[1] & 0x0F) << 8) | buf_[2]);
+		if(need > PSI_MAX_SECTION) {
+			++stats_.dropped_;
+			buf_.clear();
+			return n;
+		}
+
+		size_t take = std::min(need - buf_.size(), n - used);
+		buf_.insert(buf_.end(), d + used, d + used + take);
+		used += take;
+
+		if(buf_.size() == need) {
+			emit(&buf_[0], need, f);
+			buf_.clear();
+		}
+
+		return used;
+	}
+
+	template<typename F>
+	void emit(const uint8_t* s, size_t n, F& f) {
+		if(check_crc_ && psi_has_crc(s, n) && !Crc32Mpeg::check(s, n)) {
+			++stats_.crc_errors_;
+			return;
+		}
+		++stats_.sections_;
+		stats_.bytes_ += n;
+		f(s, n);
+	}
+
+	std::vector<uint8_t> buf_;
+	int cc_;
+	bool check_crc_;
+	SectionAssemblerStats stats_;
+};
+
+// Feeds TS packets to one SectionAssembler per selected PID
+class SectionDemux {
+public:
+	SectionDemux(bool check_crc = true) : assemblers_(TS_PID_NULL), all_(false), check_crc_(check_crc) {}
+
+	~SectionDemux() {
+		for(size_t i = 0; i < assemblers_.size(); ++i)
+			delete assemblers_[i];
+	}
+
+	// TS_PID_ALL selects every PID but the null packets
+	void add_pid(int pid) {
+		if(pid == TS_PID_ALL)
+			all_ = true;
+		else if(pid < TS_PID_NULL && !assemblers_[pid])
+			assemblers_[pid] = new SectionAssembler(check_crc_);
+	}
+
+	// Calls f(pid, section, length) for every complete section
+	template<typename F>
+	void push(const uint8_t* p, F& f) {
+		int pid = ts_pid(p);
+		if(pid >= TS_PID_NULL)
+			return;
+
+		SectionAssembler* a = assemblers_[pid];
+		if(!a) {
+			if(!all_)
+				return;
+			a = assemblers_[pid] = new SectionAssembler(check_crc_);
+		}
+
+		Bind<F> b = {pid, f};
+		a->push(p, b);
+	}
+
+	SectionAssemblerStats stats() const {
+		SectionAssemblerStats s = {0};
+		for(size_t i = 0; i < assemblers_.size(); ++i) {
+			if(!assemblers_[i])
+				continue;
+			SectionAssemblerStats const& a = assemblers_[i]->stats();
+			s.sections_ += a.sections_;
+			s.bytes_ += a.bytes_;
+			s.crc_errors_ += a.crc_errors_;
+			s.cc_errors_ += a.cc_errors_;
+			s.duplicates_ += a.duplicates_;
+			s.dropped_ += a.dropped_;
+		}
+		return s;
+	}
+
+private:
+	SectionDemux(SectionDemux const&);
+	SectionDemux& operator = (SectionDemux const&);
+
+	template<typename F>
+	struct Bind {
+		int pid_;
+		F& f_;
+		void operator () (const uint8_t* s, size_t n) { f_(pid_, s, n); }
+	};
+
+	std::vector<SectionAssembler*> assemblers_;
+	bool all_;
+	bool check_crc_;
+};
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef _RECORD_H_
+#define _RECORD_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "section.h"
+#include "json.h"
+
+// The parse-* tools describe a decoded section once, as a sequence of
+// named fields, objects and arrays, to a record writer given as template
+// parameter. JsonRecord prints the fields as JSON, BinaryRecord lays them
+// out in the binary record format below, so both outputs always carry the
+// same fields in the same order.
+//
+// Binary record format
+//
+// A stream of records, each one starting with a 12 byte header:
+//
+//	uint32	size of the record in bytes, header included, a multiple of 4
+//	uint16	kind, one of RecordKind
+//	uint16	format, RECORD_FORMAT
+//	uint32	offset of the root object
+//
+// All numbers are little-endian. Offsets count from the start of the record
+// and are multiples of 4. An object is the sequence of its fields, each of
+// them one or two 32-bit words:
+//
+//	number, flag	uint32
+//	hex		uint32, a number JSON prints in hexadecimal (BCD fields)
+//	code		4 bytes, a 3 character code such as ISO_639_language_code, NUL padded
+//	text		uint32 offset, uint32 length of UTF-8 bytes followed by a NUL
+//	time		int64 seconds since the epoch in UTC, -1 if undefined
+//	duration	uint32 seconds, 0xFFFFFFFF if undefined
+//	array		uint32 offset, uint32 count of a table of uint32 object offsets
+//
+// The fields of a record are the fields of the tool's JSON output, in the
+// same order; objects in an array of descriptors start with the tag, which
+// tells which fields follow (together with the private_data_specifier for
+// tags from 0x80 up, see descriptors.h). A reader can mmap the output and
+// walk it without parsing anything.
+
+enum RecordKind {
+	RECORD_PAT = 1,
+	RECORD_PMT = 2,
+	RECORD_NIT = 3,
+	RECORD_SDT = 4,
+	RECORD_EIT = 5,
+	RECORD_SCAN = 6,
+	RECORD_CHANNEL = 7,
+	RECORD_TS_ANALYSIS = 8
+};
+
+enum {
+	RECORD_FORMAT = 1,
+	RECORD_HEADER_SIZE = 12
+};
+
+// Fields as JSON object members, a record per line is the caller's business.
+// Members written outside begin()/end() need no enclosing object, which is
+// how secdiff.h collects the header fields of a table. There is no space
+// anywhere between tokens; the two the tools once printed by hand (PMT
+// before "streams", NIT before "modulation") are gone.
+class JsonRecord {
+public:
+	explicit JsonRecord(JsonWriter& os) : os_(os), depth_(0) {
+		first_[0] = true;
+	}
+
+	void begin(RecordKind) {
+		depth_ = 0;
+		first_[0] = true;
+		object();
+	}
+
+	void end() {
+		end_object();
+	}
+
+	void object() {
+		open(0, '{');
+	}
+
+	void end_object() {
+		close('}');
+	}
+
+	void array(const char* name) {
+		open(name, '[');
+	}
+
+	void end_array() {
+		close(']');
+	}
+
+	void number(const char* name, uint32_t v) {
+		member(name) << v;
+	}
+
+	void flag(const char* name, bool v) {
+		member(name) << v;
+	}
+
+	void hex(const char* name, uint32_t v) {
+		member(name) << json_hex(v);
+	}
+
+	// 'strict' as for json_string()
+	void text(const char* name, std::string const& s, bool strict = true) {
+		member(name) << '"' << json_string(s, strict) << '"';
+	}
+
+	void code(const char* name, ByteView v) {
+		size_t n = 0;
+		while(n < v.size() && v.data()[n])
+			++n;
+		member(name) << '"' << json_string(reinterpret_cast<const char*>(v.data()), n) << '"';
+	}
+
+	// ISO 8601 date and time, empty if undefined
+	void time(const char* name, uint16_t mjd, uint32_t bcd) {
+		member(name) << '"';
+		int year, month, day, hour, minute, second;
+		if(mjd_to_date(mjd, year, month, day)) {
+			bcd_to_time(bcd, hour, minute, second);
+			os_ << json_padded(year, 4) << '-' << json_padded(month, 2) << '-' << json_padded(day, 2) << 'T' <<
+				json_padded(hour, 2) << ':' << json_padded(minute, 2) << ':' << json_padded(second, 2) << 'Z';
+		}
+		os_ << '"';
+	}
+
+	// ISO 8601 duration, empty if undefined
+	void duration(const char* name, uint32_t bcd, bool defined) {
+		member(name) << '"';
+		if(defined) {
+			int hours, minutes, seconds;
+			bcd_to_time(bcd, hours, minutes, seconds);
+			os_ << "PT" << hours << "H" << minutes << "M" << seconds << "S";
+		}
+		os_ << '"';
+	}
+
+private:
+	enum { MAX_DEPTH = 16 };
+
+	JsonWriter& member(const char* name) {
+		if(!first_[depth_])
+			os_ << ',';
+		first_[depth_] = false;
+		if(name)
+			os_ << '"' << name << "\":";
+		return os_;
+	}
+
+	void open(const char* name, char c) {
+		member(name) << c;
+		if(depth_ + 1 < MAX_DEPTH)
+			++depth_;
+		first_[depth_] = true;
+	}
+
+	void close(char c) {
+		os_ << c;
+		if(depth_)
+			--depth_;
+	}
+
+	JsonWriter& os_;
+	int depth_;
+	bool first_[MAX_DEPTH];
+};
+
+// Fields in the binary record format. Objects are laid out when they are
+// closed, children before their parent, so the root object comes last.
+// Nothing reaches the JsonWriter before end(); a record that fails halfway
+// is dropped by the next begin().
+class BinaryRecord {
+public:
+	explicit BinaryRecord(JsonWriter& os) : os_(os) {}
+
+	void begin(RecordKind kind) {
+		heap_.assign(RECORD_HEADER_SIZE, 0);
+		words_.clear();
+		open_.clear();
+		kind_ = kind;
+		push();
+	}
+
+	void end() {
+		uint32_t root = close();
+
+		uint8_t* h = &heap_[0];
+		put(h, heap_.size());
+		h[4] = kind_;
+		h[5] = kind_ >> 8;
+		h[6] = RECORD_FORMAT;
+		h[7] = RECORD_FORMAT >> 8;
+		put(h + 8, root);
+		os_.append(reinterpret_cast<const char*>(&heap_[0]), heap_.size());
+	}
+
+	void object() {
+		push();
+	}
+
+	void end_object() {
+		words_.push_back(close());
+	}
+
+	void array(const char*) {
+		push();
+	}
+
+	void end_array() {
+		uint32_t count = words_.size() - open_.back();
+		words_.push_back(close());
+		words_.push_back(count);
+	}
+
+	void number(const char*, uint32_t v) {
+		words_.push_back(v);
+	}
+
+	void flag(const char*, bool v) {
+		words_.push_back(v);
+	}
+
+	void hex(const char*, uint32_t v) {
+		words_.push_back(v);
+	}
+
+	void text(const char*, std::string const& s, bool = true) {
+		uint32_t offset = heap_.size();
+		heap_.resize((offset + s.size() + 4) & ~size_t(3), 0);
+		memcpy(&heap_[offset], s.data(), s.size());
+		words_.push_back(offset);
+		words_.push_back(s.size());
+	}
+
+	void code(const char*, ByteView v) {
+		uint8_t c[4] = {0, 0, 0, 0};
+		memcpy(c, v.data(), std::min<size_t>(v.size(), 3));
+		words_.push_back(c[0] | c[1] << 8 | c[2] << 16);
+	}
+
+	void time(const char*, uint16_t mjd, uint32_t bcd) {
+		uint64_t t = mjd_to_unix(mjd, bcd);
+		words_.push_back(t);
+		words_.push_back(t >> 32);
+	}
+
+	void duration(const char*, uint32_t bcd, bool defined) {
+		words_.push_back(defined ? bcd_to_seconds(bcd) : 0xFFFFFFFF);
+	}
+
+private:
+	void push() {
+		open_.push_back(words_.size());
+	}
+
+	// Lays out the innermost open object or array, returns its offset
+	uint32_t close() {
+		size_t from = open_.back();
+		size_t n = words_.size() - from;
+		uint32_t offset = heap_.size();
+		heap_.resize(offset + n * 4);
+		uint8_t* p = &heap_[offset];
+		for(size_t i = 0; i < n; ++i, p += 4)
+			put(p, words_[from + i]);
+		words_.resize(from);
+		open_.pop_back();
+		return offset;
+	}
+
+	static void put(uint8_t* p, uint32_t v) {
+		p[0] = v;
+		p[1] = v >> 8;
+		p[2] = v >> 16;
+		p[3] = v >> 24;
+	}
+
+	JsonWriter& os_;
+	std::vector<uint8_t> heap_;
+	// fields of the open objects and arrays, innermost last; open_ holds
+	// where each of them starts
+	std::vector<uint32_t> words_;
+	std::vector<size_t> open_;
+	uint16_t kind_;
+};
+
+#endif
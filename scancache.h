@@ -0,0 +1,155 @@
+#ifndef _SCANCACHE_H_
+#define _SCANCACHE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include "section.h"
+#include "secframe.h"
+#include "servicescan.h"
+
+// A transponder in the terms tuneqpsk takes on its command line
+struct Transponder {
+	uint32_t frequency_;	// kHz
+	char polarization_;	// 'H', 'V', 'L' or 'R'
+	uint32_t symbol_rate_;	// Sym/s
+	const char* fec_;	// "1_2" ... "8_9", "AUTO", "NONE"
+};
+
+// The transponder of a satellite_delivery_system_descriptor, false for
+// DVB-S2, which tuneqpsk cannot tune
+inline bool delivery_transponder(SatelliteDeliveryDescriptor const& sd, Transponder& t) {
+	// FEC_inner of EN 300 468, 3/5 and 9/10 are left to the frontend
+	static const char* fec[16] = {
+		"AUTO", "1_2", "2_3", "3_4", "5_6", "7_8", "8_9", "AUTO",
+		"4_5", "AUTO", "AUTO", "AUTO", "AUTO", "AUTO", "AUTO", "NONE"
+	};
+
+	if(sd.modulation() & 0x04)
+		return false;
+
+	t.frequency_ = bcd_to_uint(sd.frequency(), 8) * 10;
+	t.polarization_ = "HVLR"[sd.polarization()];
+	t.symbol_rate_ = bcd_to_uint(sd.symbol_rate(), 7) * 100;
+	t.fec_ = fec[sd.fec_inner() & 0xF];
+	return true;
+}
+
+// (original_network_id, transport_stream_id)
+typedef std::pair<uint16_t, uint16_t> TransportKey;
+
+inline TransportKey transport_key(ServiceScan const& scan) {
+	return TransportKey(scan.original_network_id(), scan.transport_stream_id());
+}
+
+// Complete scans of multiplexes, kept from run to run in a file of
+// sec-collect frames (secframe.h). The frames of a multiplex start with
+// section 0 of its PAT; their timestamps are the scan times given to
+// ServiceScan::add(), not times since the epoch.
+class ScanCache {
+public:
+	// True if the file was read or does not exist
+	bool load(const char* path) {
+		int fd = open(path, O_RDONLY);
+		if(fd < 0)
+			return errno == ENOENT;
+
+		std::string data;
+		char buf[65536];
+		ssize_t n;
+		while((n = read(fd, buf, sizeof(buf))) > 0)
+			data.append(buf, n);
+		close(fd);
+		if(n < 0)
+			return false;
+
+		const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data());
+		size_t size = data.size();
+		ServiceScan scan;
+		bool started = false;
+		for(size_t off = 0; off + SECFRAME_HEADER_SIZE <= size;) {
+			secframe f;
+			if(secframe_read(p + off, &f) != 0 || off + SECFRAME_HEADER_SIZE + f.length > size) {
+				fprintf(stderr, "%s: damaged at offset %zu, ignoring the rest\n", path, off);
+				break;
+			}
+			const uint8_t* s = p + off + SECFRAME_HEADER_SIZE;
+			off += SECFRAME_HEADER_SIZE + f.length;
+
+			if(f.pid == 0x00 && f.table_id == 0x00 && f.length > 6 && s[6] == 0) {
+				if(started)
+					put(scan);
+				scan = ServiceScan();
+				started = true;
+			}
+			scan.add(f.pid, s, f.length, f.timestamp);
+		}
+		if(started)
+			put(scan);
+		return true;
+	}
+
+	// Writes a new file and renames it over 'path'
+	bool save(const char* path) const {
+		std::string tmp = std::string(path) + ".tmp";
+		FILE* f = fopen(tmp.c_str(), "wb");
+		if(!f)
+			return false;
+
+		Writer w = {f, true};
+		for(std::map<TransportKey, ServiceScan>::const_iterator i = scans_.begin(); i != scans_.end(); ++i)
+			i->second.sections(w);
+		if(fclose(f) != 0 || !w.good_ || rename(tmp.c_str(), path) != 0) {
+			unlink(tmp.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	// Keeps a complete scan, replacing the one of the same multiplex
+	void put(ServiceScan const& scan) {
+		if(scan.complete())
+			scans_[transport_key(scan)] = scan;
+	}
+
+	// The scan of a multiplex, 0 if there is none
+	ServiceScan const* find(TransportKey key) const {
+		std::map<TransportKey, ServiceScan>::const_iterator i = scans_.find(key);
+		return i == scans_.end() ? 0 : &i->second;
+	}
+
+	// The scan of a multiplex made while the NIT of 'network_id' had this version
+	ServiceScan const* find(TransportKey key, uint16_t network_id, int nit_version) const {
+		std::map<TransportKey, ServiceScan>::const_iterator i = scans_.find(key);
+		if(i == scans_.end() || i->second.network_id() != network_id || i->second.nit_version() != nit_version)
+			return 0;
+		return &i->second;
+	}
+
+	size_t size() const { return scans_.size(); }
+	std::map<TransportKey, ServiceScan> const& scans() const { return scans_; }
+
+private:
+	struct Writer {
+		FILE* f_;
+		bool good_;
+
+		void operator () (uint16_t pid, ByteView s, uint64_t time) {
+			secframe frame = {pid, s.data()[0], uint16_t(s.size()), time};
+			uint8_t h[SECFRAME_HEADER_SIZE];
+			secframe_write(h, &frame);
+			good_ = good_ && fwrite(h, sizeof(h), 1, f_) == 1 && fwrite(s.data(), s.size(), 1, f_) == 1;
+		}
+	};
+
+	std::map<TransportKey, ServiceScan> scans_;
+};
+
+#endif
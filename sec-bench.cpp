@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "section.h"
+#include "secstream.h"
+#include "json.h"
+#include "record.h"
+#include "descriptors.h"
+#include "tables.h"
+
+void usage() {
+	fprintf(stderr, "usage: sec-bench [-F] [-b] [-n rounds] [-z seed] < sections\n"
+		"\tdecodes the PAT, PMT, NIT, SDT and EIT sections of the input the way parse-* do,\n"
+		"\t'rounds' times over (default 10) with the output thrown away, and reports\n"
+		"\tsections/s and MB/s per table\n"
+		"\t-F\tinput is framed by sec-collect or ts2sec -F\n"
+		"\t-b\tbinary records instead of JSON, see record.h\n"
+		"\t-z\tcorrupt every section at random before decoding it, starting from this seed, and\n"
+		"\t\treport how many were rejected; every section gets a buffer of its exact size, so a\n"
+		"\t\tbuild with CXX=\"g++ -fsanitize=address,undefined\" catches reads past its end\n");
+	exit(1);
+}
+
+enum Table { PAT, PMT, NIT, SDT, EIT, TABLES };
+
+static const char* table_names[TABLES] = {"pat", "pmt", "nit", "sdt", "eit"};
+
+// The table a section belongs to, as the parse-* tools filter them
+int table_of(uint8_t table_id) {
+	if(table_id == 0x00) return PAT;
+	if(table_id == 0x02) return PMT;
+	if(table_id == 0x40 || table_id == 0x41) return NIT;
+	if(table_id == 0x42 || table_id == 0x46) return SDT;
+	if(table_id >= 0x4E && table_id <= 0x6F) return EIT;
+	return -1;
+}
+
+// The writers of all tables with the descriptors each tool registers, or
+// all of them for -z
+template<class Out>
+struct Decoder {
+	Decoder(JsonWriter& os, bool all) : out_(os) {
+		if(all) {
+			for(int i = 0; i < TABLES; ++i)
+				add_all_descriptors(descriptors_[i]);
+			return;
+		}
+		add_pmt_descriptors(descriptors_[PMT]);
+		add_nit_descriptors(descriptors_[NIT]);
+		add_sdt_descriptors(descriptors_[SDT]);
+		add_eit_descriptors(descriptors_[EIT]);
+	}
+
+	void operator () (int table, const uint8_t* s, size_t n) {
+		ByteView v(s, n);
+		switch(table) {
+		case PAT: write_pat(out_, PatSection(v)); break;
+		case PMT: write_pmt(out_, PmtSection(v), descriptors_[PMT]); break;
+		case NIT: write_nit(out_, NitSection(v), descriptors_[NIT]); break;
+		case SDT: write_sdt(out_, SdtSection(v), descriptors_[SDT]); break;
+		case EIT: write_eit(out_, EitSection(v), descriptors_[EIT]); break;
+		}
+	}
+
+	Out out_;
+	DescriptorRegistry<Out> descriptors_[TABLES];
+};
+
+struct Corpus {
+	std::vector<std::string> sections_[TABLES];
+	uint64_t bytes_[TABLES];
+};
+
+uint64_t now_ns() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+template<class Out>
+void bench(Corpus const& c, unsigned rounds) {
+	JsonWriter os(-1);
+	Decoder<Out> decode(os, false);
+
+	printf("table\tsections\tbytes\terrors\tsections/s\tMB/s\n");
+	uint64_t total_sections = 0, total_bytes = 0, total_ns = 0;
+	for(int t = 0; t < TABLES; ++t) {
+		std::vector<std::string> const& sections = c.sections_[t];
+		if(sections.empty())
+			continue;
+
+		uint64_t errors = 0;
+		uint64_t start = now_ns();
+		for(unsigned r = 0; r < rounds; ++r) {
+			for(size_t i = 0; i < sections.size(); ++i) {
+				try {
+					decode(t, reinterpret_cast<const uint8_t*>(sections[i].data()), sections[i].size());
+				}
+				catch(std::exception const&) {
+					++errors;
+				}
+				os.truncate(0);
+			}
+		}
+		uint64_t ns = std::max<uint64_t>(now_ns() - start, 1);
+
+		uint64_t n = uint64_t(sections.size()) * rounds;
+		uint64_t bytes = c.bytes_[t] * rounds;
+		printf("%s\t%llu\t%llu\t%llu\t%.0f\t%.1f\n", table_names[t], (unsigned long long)n, (unsigned long long)bytes,
+			(unsigned long long)errors, n * 1e9 / ns, bytes * 1e3 / ns);
+		total_sections += n;
+		total_bytes += bytes;
+		total_ns += ns;
+	}
+	if(total_ns)
+		printf("all\t%llu\t%llu\t\t%.0f\t%.1f\n", (unsigned long long)total_sections, (unsigned long long)total_bytes,
+			total_sections * 1e9 / total_ns, total_bytes * 1e3 / total_ns);
+}
+
+// xorshift64, the same corruptions for the same seed on every machine
+struct Random {
+	explicit Random(uint64_t seed) : x_(seed * 2654435761u + 1) {}
+
+	uint32_t operator () (uint32_t n) {
+		x_ ^= x_ << 13;
+		x_ ^= x_ >> 7;
+		x_ ^= x_ << 17;
+		return uint32_t(x_ >> 32) % n;
+	}
+
+	uint64_t x_;
+};
+
+// One to four changes, aimed at what parsers trust: length fields are
+// bytes like any other, so setting bytes to 0x00 and 0xFF or cutting the
+// section short reaches their limits quickly
+void corrupt(std::vector<uint8_t>& s, Random& random) {
+	for(unsigned k = 1 + random(4); k; --k) {
+		size_t i = random(s.size());
+		switch(random(4)) {
+		case 0: s[i] = random(256); break;
+		case 1: s[i] ^= 1 << random(8); break;
+		case 2: s[i] = random(2) ? 0xFF : 0x00; break;
+		case 3: s.resize(std::max<size_t>(3, i)); break;
+		}
+	}
+}
+
+template<class Out>
+void fuzz(Corpus const& c, unsigned rounds, uint64_t seed) {
+	JsonWriter os(-1);
+	Decoder<Out> decode(os, true);
+	Random random(seed);
+
+	printf("table\tsections\tdecoded\trejected\n");
+	for(int t = 0; t < TABLES; ++t) {
+		std::vector<std::string> const& sections = c.sections_[t];
+		if(sections.empty())
+			continue;
+
+		uint64_t decoded = 0, rejected = 0;
+		for(unsigned r = 0; r < rounds; ++r) {
+			for(size_t i = 0; i < sections.size(); ++i) {
+				std::vector<uint8_t> s(sections[i].begin(), sections[i].end());
+				corrupt(s, random);
+				// resize() keeps the capacity, a copy has none to spare behind the section
+				std::vector<uint8_t> exact(s);
+				try {
+					decode(t, &exact[0], exact.size());
+					++decoded;
+				}
+				catch(std::exception const&) {
+					++rejected;
+				}
+				os.truncate(0);
+			}
+		}
+		printf("%s\t%llu\t%llu\t%llu\n", table_names[t], (unsigned long long)(decoded + rejected),
+			(unsigned long long)decoded, (unsigned long long)rejected);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	bool framed = false;
+	bool binary = false;
+	bool corrupted = false;
+	unsigned rounds = 10;
+	uint64_t seed = 0;
+
+	int opt;
+	while((opt = getopt(argc, argv, "Fbn:z:")) != -1) {
+		switch(opt) {
+		case 'F': framed = true; break;
+		case 'b': binary = true; break;
+		case 'n': rounds = atoi(optarg); break;
+		case 'z': corrupted = true; seed = strtoull(optarg, 0, 0); break;
+		default: usage();
+		}
+	}
+	if(optind != argc || rounds == 0)
+		usage();
+
+	Corpus c;
+	for(int t = 0; t < TABLES; ++t)
+		c.bytes_[t] = 0;
+
+	SectionStream in(STDIN_FILENO, framed);
+	const uint8_t* s;
+	size_t n;
+	while(in.next(s, n)) {
+		int t = table_of(s[0]);
+		if(t < 0)
+			continue;
+		c.sections_[t].push_back(std::string(reinterpret_cast<const char*>(s), n));
+		c.bytes_[t] += n;
+	}
+
+	if(corrupted) {
+		if(binary)
+			fuzz<BinaryRecord>(c, rounds, seed);
+		else
+			fuzz<JsonRecord>(c, rounds, seed);
+	}
+	else {
+		if(binary)
+			bench<BinaryRecord>(c, rounds);
+		else
+			bench<JsonRecord>(c, rounds);
+	}
+
+	if(in.skipped() || in.invalid())
+		fprintf(stderr, "sec-bench: %llu invalid sections, %llu bytes skipped\n",
+			(unsigned long long)in.invalid(), (unsigned long long)in.skipped());
+	return 0;
+}
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <linux/dvb/dmx.h>
+
+#include <vector>
+
+#include "secframe.h"
+#include "secdedup.h"
+
+static volatile sig_atomic_t g_stop = 0;
+
+void sighandler(int n) {
+	g_stop = 1;
+}
+
+void usage() {
+	fprintf(stderr, "usage: sec-collect [-r] [-a] [-b buffer_size] [-t seconds] device_name pid[:filter[:mask]] ...\n"
+		"\t-r\twrite bare sections without framing\n"
+		"\t-a\tdeliver every section, including repeats\n");
+	exit(1);
+}
+
+int parse_hex(const char* s, const char* end, uint8_t* out) {
+	size_t i = 0;
+	for(; s + 1 < end && i < DMX_FILTER_SIZE; s += 2, ++i) {
+		int v;
+		if(1 != sscanf(s, "%2x", &v))
+			return -1;
+		out[i] = v;
+	}
+	return s == end ? 0 : -1;
+}
+
+int parse_filter(const char* spec, dmx_sct_filter_params& params) {
+	memset(&params, 0, sizeof(params));
+
+	char* e;
+	params.pid = strtoul(spec, &e, 0);
+	if(e == spec || params.pid >= 0x1FFF)
+		return -1;
+
+	if(*e == ':') {
+		const char* f = e + 1;
+		const char* m = strchr(f, ':');
+		if(parse_hex(f, m ? m : f + strlen(f), params.filter.filter) != 0)
+			return -1;
+		if(m && parse_hex(m + 1, m + 1 + strlen(m + 1), params.filter.mask) != 0)
+			return -1;
+		if(!m)
+			memset(params.filter.mask, 0xFF, (strlen(f) + 1) / 2);
+	}
+	else if(*e)
+		return -1;
+
+	params.flags = DMX_IMMEDIATE_START | DMX_CHECK_CRC;
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	bool raw = false;
+	bool all = false;
+	int buffer_size = 64*1024;
+	int timeout = -1;
+
+	int opt;
+	while((opt = getopt(argc, argv, "rab:t:")) != -1) {
+		switch(opt) {
+		case 'r': raw = true; break;
+		case 'a': all = true; break;
+		case 'b': buffer_size = atoi(optarg); break;
+		case 't': timeout = atoi(optarg); break;
+		default: usage();
+		}
+	}
+
+	if(argc - optind < 2)
+		usage();
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sighandler;
+	sigaction(SIGTERM, &sa, 0);
+	sigaction(SIGINT, &sa, 0);
+	sigaction(SIGALRM, &sa, 0);
+
+	const char* device = argv[optind];
+	std::vector<pollfd> fds;
+	std::vector<uint16_t> pids;
+
+	for(int i = optind + 1; i < argc; ++i) {
+		dmx_sct_filter_params params;
+		if(parse_filter(argv[i], params) != 0) {
+			fprintf(stderr, "invalid filter %s\n", argv[i]);
+			return 1;
+		}
+
+		int fd = open(device, O_RDWR | O_NONBLOCK);
+		if(fd < 0) {
+			perror("failed to open demuxer");
+			return 1;
+		}
+
+		if(ioctl(fd, DMX_SET_BUFFER_SIZE, buffer_size) != 0) {
+			fprintf(stderr, "failed to set buffer size\n");
+			return 1;
+		}
+
+		if(ioctl(fd, DMX_SET_FILTER, &params) != 0) {
+			fprintf(stderr, "failed to set filter %s\n", argv[i]);
+			return 1;
+		}
+
+		pollfd p = {fd, POLLIN, 0};
+		fds.push_back(p);
+		pids.push_back(params.pid);
+	}
+
+	if(timeout > 0)
+		alarm(timeout);
+
+	SectionDedup dedup;
+	std::vector<uint8_t> out;
+	uint8_t buf[SECFRAME_HEADER_SIZE + 4096];
+	uint64_t sections = 0, overflows = 0;
+
+	while(!g_stop) {
+		int r = poll(&fds[0], fds.size(), -1);
+		if(r < 0) {
+			if(errno == EINTR) continue;
+			perror("poll");
+			break;
+		}
+
+		timeval tv;
+		gettimeofday(&tv, 0);
+
+		for(size_t i = 0; i < fds.size(); ++i) {
+			if(!(fds[i].revents & (POLLIN | POLLERR)))
+				continue;
+
+			// a section filter returns one section per read
+			for(;;) {
+				int n = read(fds[i].fd, buf + SECFRAME_HEADER_SIZE, sizeof(buf) - SECFRAME_HEADER_SIZE);
+				if(n < 0) {
+					if(errno == EOVERFLOW) {
+						++overflows;
+						continue;
+					}
+					if(errno != EAGAIN && errno != EINTR)
+						perror("read");
+					break;
+				}
+				if(n < 3)
+					break;
+
+				++sections;
+				if(!all && !dedup.is_new(pids[i], buf + SECFRAME_HEADER_SIZE, n))
+					continue;
+
+				secframe f = {pids[i], buf[SECFRAME_HEADER_SIZE], uint16_t(n), uint64_t(tv.tv_sec) * 1000000 + tv.tv_usec};
+				secframe_write(buf, &f);
+
+				uint8_t* b = raw ? buf + SECFRAME_HEADER_SIZE : buf;
+				out.insert(out.end(), b, buf + SECFRAME_HEADER_SIZE + n);
+			}
+		}
+
+		for(size_t w = 0; w < out.size();) {
+			ssize_t n = write(STDOUT_FILENO, &out[w], out.size() - w);
+			if(n < 0) {
+				if(errno == EINTR) continue;
+				perror("write");
+				return 1;
+			}
+			w += n;
+		}
+		out.clear();
+	}
+
+	SectionDedupStats const& st = dedup.stats();
+	fprintf(stderr, "sec-collect: %llu sections, %llu repeats suppressed, %llu new or changed, %llu without CRC, %llu overflows\n",
+		(unsigned long long)sections, (unsigned long long)st.hits_, (unsigned long long)st.misses_,
+		(unsigned long long)st.uncached_, (unsigned long long)overflows);
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+#ifndef _SECDEDUP_H_
+#define _SECDEDUP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <unordered_map>
+
+#include "psi.h"
+
+struct SectionDedupStats {
+	// repeats of a section already seen
+	uint64_t hits_;
+	// new or changed sections
+	uint64_t misses_;
+	// sections that cannot be told apart from their header, always passed
+	uint64_t uncached_;
+};
+
+// Recognises repeated sections without looking at their body. A section is
+// keyed by PID, table_id, table_id_extension and section_number, plus
+// transport_stream_id and original_network_id for EIT where services of
+// several multiplexes share a PID. It is a repeat when version,
+// current_next_indicator, length and the trailing CRC_32 are the same as
+// last time. Sections without a CRC_32 (TDT, ...) are always new.
+class SectionDedup {
+public:
+	SectionDedup() : stats_() {}
+
+	// True if the section is new or differs from the last one with its key
+	bool is_new(uint16_t pid, const uint8_t* s, size_t n) {
+		if(n < 7 || !psi_has_crc(s, n)) {
+			++stats_.uncached_;
+			return true;
+		}
+
+		Key key;
+		key.id_ = uint64_t(pid) << 40 | uint64_t(s[0]) << 32;
+		if(s[1] & 0x80) {
+			key.id_ |= s[3] << 16 | s[4] << 8 | s[6];
+			if(s[0] >= 0x4E && s[0] <= 0x6F && n >= 12)
+				key.ts_ = s[8] << 24 | s[9] << 16 | s[10] << 8 | s[11];
+		}
+
+		Value value;
+		value.crc_ = s[n - 4] << 24 | s[n - 3] << 16 | s[n - 2] << 8 | s[n - 1];
+		value.length_ = n;
+		value.version_ = (s[1] & 0x80) ? s[5] & 0x3F : 0;
+
+		Value& last = seen_[key];
+		if(last.crc_ == value.crc_ && last.length_ == value.length_ && last.version_ == value.version_) {
+			++stats_.hits_;
+			return false;
+		}
+
+		last = value;
+		++stats_.misses_;
+		return true;
+	}
+
+	// Makes every section new again, e.g. after a retune
+	void clear() {
+		seen_.clear();
+	}
+
+	size_t size() const { return seen_.size(); }
+
+	SectionDedupStats const& stats() const { return stats_; }
+
+private:
+	struct Key {
+		Key() : id_(0), ts_(0) {}
+
+		bool operator == (Key const& k) const { return id_ == k.id_ && ts_ == k.ts_; }
+
+		uint64_t id_;
+		uint32_t ts_;
+	};
+
+	struct KeyHash {
+		size_t operator () (Key const& k) const {
+			uint64_t h = (k.id_ ^ (uint64_t(k.ts_) << 7)) * 0x9E3779B97F4A7C15ull;
+			return h ^ (h >> 29);
+		}
+	};
+
+	// length_ 0 marks an entry created by the lookup
+	struct Value {
+		Value() : crc_(0), length_(0), version_(0) {}
+
+		uint32_t crc_;
+		uint16_t length_;
+		uint8_t version_;
+	};
+
+	std::unordered_map<Key, Value, KeyHash> seen_;
+	SectionDedupStats stats_;
+};
+
+#endif
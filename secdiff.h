@@ -0,0 +1,161 @@
+#ifndef _SECDIFF_H_
+#define _SECDIFF_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "section.h"
+#include "json.h"
+
+// One entry of a table loop: a program, stream, transport or service
+struct TableItem {
+	// the entry as the tool prints it
+	std::string json_;
+	// raw descriptors, tag and length included
+	std::vector<std::string> descriptors_;
+
+	bool operator == (TableItem const& i) const { return json_ == i.json_ && descriptors_ == i.descriptors_; }
+	bool operator != (TableItem const& i) const { return !(*this == i); }
+};
+
+// What a tool decoded from one section, split up so two of them can be
+// compared entry by entry. Items are keyed by what identifies them in the
+// loop: program_number, elementary_PID, service_id, ...
+struct TableSnapshot {
+	TableSnapshot() : version_(-1) {}
+
+	int version_;
+	// fields outside the loop, as JSON object members
+	TableItem header_;
+	std::map<uint32_t, TableItem> items_;
+};
+
+inline std::vector<std::string> raw_descriptors(DescriptorLoop const& loop) {
+	std::vector<std::string> r;
+	for(DescriptorLoop::iterator i = loop.begin(); i != loop.end(); ++i) {
+		ByteView v = (*i).view();
+		r.push_back(std::string(reinterpret_cast<const char*>(v.data()), v.size()));
+	}
+	return r;
+}
+
+// Keeps the last snapshot of every table and writes one JSON record per
+// change: version bumps, entries added, removed or changed, and the
+// descriptors that were added or removed within a changed entry.
+class TableDiff {
+public:
+	TableDiff() : changes_(0), unchanged_(0) {}
+
+	// 'table' names the table in the record, 'id' holds the JSON members
+	// that identify it. Returns true if a record was written.
+	bool update(JsonWriter& os, const char* table, uint64_t key, std::string const& id, TableSnapshot& now) {
+		std::unordered_map<uint64_t, TableSnapshot>::iterator i = last_.find(key);
+		TableSnapshot* old = i == last_.end() ? 0 : &i->second;
+
+		if(old && old->version_ == now.version_ && old->header_ == now.header_ && old->items_ == now.items_) {
+			++unchanged_;
+			return false;
+		}
+
+		os << "{\"table\":\"" << table << "\"," << id << ",\"version\":" << now.version_;
+		if(old)
+			os << ",\"old_version\":" << old->version_;
+		else
+			os << ",\"new\":true";
+
+		if(!old || old->header_ != now.header_) {
+			os << ",\"header\":{";
+			if(old) {
+				os << "\"old\":{" << old->header_.json_ << "},";
+				write_descriptor_changes(os, old->header_, now.header_);
+			}
+			os << "\"new\":{" << now.header_.json_ << "}}";
+		}
+
+		static const std::map<uint32_t, TableItem> none;
+		std::map<uint32_t, TableItem> const& before = old ? old->items_ : none;
+
+		write_items(os, "added", now.items_, before);
+		write_items(os, "removed", before, now.items_);
+
+		bool first = true;
+		for(std::map<uint32_t, TableItem>::const_iterator j = now.items_.begin(); j != now.items_.end(); ++j) {
+			std::map<uint32_t, TableItem>::const_iterator k = before.find(j->first);
+			if(k == before.end() || k->second == j->second)
+				continue;
+			os << (first ? ",\"changed\":[" : ",") << "{\"old\":" << k->second.json_ << ",";
+			write_descriptor_changes(os, k->second, j->second);
+			os << "\"new\":" << j->second.json_ << "}";
+			first = false;
+		}
+		if(!first)
+			os << "]";
+
+		os << "}";
+
+		if(old)
+			std::swap(*old, now);
+		else
+			std::swap(last_[key], now);
+		++changes_;
+		return true;
+	}
+
+	uint64_t changes() const { return changes_; }
+	uint64_t unchanged() const { return unchanged_; }
+
+private:
+	// entries of 'a' that 'b' does not have
+	static void write_items(JsonWriter& os, const char* name, std::map<uint32_t, TableItem> const& a, std::map<uint32_t, TableItem> const& b) {
+		bool first = true;
+		for(std::map<uint32_t, TableItem>::const_iterator i = a.begin(); i != a.end(); ++i) {
+			if(b.count(i->first))
+				continue;
+			if(first)
+				os << ",\"" << name << "\":[";
+			else
+				os << ",";
+			os << i->second.json_;
+			first = false;
+		}
+		if(!first)
+			os << "]";
+	}
+
+	// "descriptors":{"added":[...],"removed":[...]}, followed by a comma, if any differ
+	static void write_descriptor_changes(JsonWriter& os, TableItem const& a, TableItem const& b) {
+		if(a.descriptors_ == b.descriptors_)
+			return;
+		os << "\"descriptors\":{\"added\":[";
+		write_missing(os, b.descriptors_, a.descriptors_);
+		os << "],\"removed\":[";
+		write_missing(os, a.descriptors_, b.descriptors_);
+		os << "]},";
+	}
+
+	static void write_missing(JsonWriter& os, std::vector<std::string> const& a, std::vector<std::string> const& b) {
+		bool first = true;
+		for(size_t i = 0; i < a.size(); ++i) {
+			if(std::find(b.begin(), b.end(), a[i]) != b.end())
+				continue;
+			os << (first ? "" : ",") << "{\"tag\":" << (uint32_t)(uint8_t)a[i][0] << ",\"data\":\"";
+			for(size_t j = 2; j < a[i].size(); ++j) {
+				uint8_t c = a[i][j];
+				os << "0123456789abcdef"[c >> 4] << "0123456789abcdef"[c & 0xF];
+			}
+			os << "\"}";
+			first = false;
+		}
+	}
+
+	std::unordered_map<uint64_t, TableSnapshot> last_;
+	uint64_t changes_;
+	uint64_t unchanged_;
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef _SECFILTER_H_
+#define _SECFILTER_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <linux/dvb/dmx.h>
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+// Userspace counterpart of the demux section filter. Rules use the layout
+// of dmx_filter: byte 0 is table_id, bytes 1..15 match section bytes 3..17
+// (section_length is skipped). Mode bits set to 1 select negative match:
+// at least one of those bits has to differ, like the kernel does it.
+struct SectionFilter {
+	uint8_t filter_[DMX_FILTER_SIZE];
+	uint8_t mask_[DMX_FILTER_SIZE];
+	uint8_t mode_[DMX_FILTER_SIZE];
+};
+
+struct SectionFilterStats {
+	uint64_t sections_;
+	uint64_t bytes_;
+	// rules actually compared against a section
+	uint64_t compares_;
+	uint64_t matches_;
+};
+
+class SectionFilterSet {
+public:
+	SectionFilterSet() : stats_() {}
+
+	// Returns the rule id, ids are assigned in order starting from 0
+	size_t add(SectionFilter const& f) {
+		Rule r;
+		uint8_t pos[DMX_FILTER_SIZE], neg[DMX_FILTER_SIZE], pval[DMX_FILTER_SIZE], nval[DMX_FILTER_SIZE];
+
+		r.has_neg_ = false;
+		for(size_t i = 0; i < DMX_FILTER_SIZE; ++i) {
+			pos[i] = f.mask_[i] & ~f.mode_[i];
+			neg[i] = f.mask_[i] & f.mode_[i];
+			pval[i] = f.filter_[i] & pos[i];
+			nval[i] = f.filter_[i] & neg[i];
+			r.has_neg_ |= neg[i] != 0;
+		}
+		pack(pos, r.pos_);
+		pack(neg, r.neg_);
+		pack(pval, r.pval_);
+		pack(nval, r.nval_);
+
+		size_t id = rules_.size();
+		rules_.push_back(r);
+
+		// index on table_id and table_id_extension when the rule pins them
+		if(pos[0] != 0xFF)
+			wildcard_.push_back(id);
+		else if(pos[1] == 0xFF && pos[2] == 0xFF)
+			tables_[pval[0]].by_ext_[(pval[1] << 8) | pval[2]].push_back(id);
+		else
+			tables_[pval[0]].any_ext_.push_back(id);
+
+		return id;
+	}
+
+	size_t size() const { return rules_.size(); }
+
+	// Appends ids of all matching rules to 'ids', returns true on any match
+	bool match(const uint8_t* section, size_t length, std::vector<size_t>& ids) {
+		uint8_t key[DMX_FILTER_SIZE] = {0};
+		if(length > 0) key[0] = section[0];
+		if(length > 3) memcpy(key + 1, section + 3, std::min(length - 3, size_t(DMX_FILTER_SIZE - 1)));
+
+		uint64_t k[2];
+		pack(key, k);
+
+		size_t before = ids.size();
+
+		++stats_.sections_;
+		stats_.bytes_ += length;
+
+		scan(wildcard_, k, ids);
+
+		Table const& t = tables_[key[0]];
+		scan(t.any_ext_, k, ids);
+		if(!t.by_ext_.empty()) {
+			std::unordered_map<uint16_t, std::vector<size_t> >::const_iterator i = t.by_ext_.find((key[1] << 8) | key[2]);
+			if(i != t.by_ext_.end())
+				scan(i->second, k, ids);
+		}
+
+		stats_.matches_ += ids.size() - before;
+		return ids.size() != before;
+	}
+
+	SectionFilterStats const& stats() const { return stats_; }
+
+private:
+	struct Rule {
+		uint64_t pos_[2];
+		uint64_t pval_[2];
+		uint64_t neg_[2];
+		uint64_t nval_[2];
+		bool has_neg_;
+	};
+
+	struct Table {
+		std::vector<size_t> any_ext_;
+		std::unordered_map<uint16_t, std::vector<size_t> > by_ext_;
+	};
+
+	static void pack(const uint8_t* b, uint64_t* w) {
+		memcpy(w, b, DMX_FILTER_SIZE);
+	}
+
+	void scan(std::vector<size_t> const& list, const uint64_t* k, std::vector<size_t>& ids) {
+		stats_.compares_ += list.size();
+		for(size_t i = 0; i < list.size(); ++i) {
+			Rule const& r = rules_[list[i]];
+			if(((k[0] & r.pos_[0]) ^ r.pval_[0]) | ((k[1] & r.pos_[1]) ^ r.pval_[1]))
+				continue;
+			if(r.has_neg_ && !(((k[0] & r.neg_[0]) ^ r.nval_[0]) | ((k[1] & r.neg_[1]) ^ r.nval_[1])))
+				continue;
+			ids.push_back(list[i]);
+		}
+	}
+
+	std::vector<Rule> rules_;
+	std::vector<size_t> wildcard_;
+	Table tables_[256];
+	SectionFilterStats stats_;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef _SECFRAME_H_
+#define _SECFRAME_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Framed section record written by sec-collect. All fields are big endian.
+ *
+ *   0  'S' 'C'    magic
+ *   2  pid        16 bit
+ *   4  table_id   8 bit, same as the first section byte
+ *   5  reserved   8 bit, zero
+ *   6  length     16 bit, number of section bytes following the header
+ *   8  timestamp  64 bit, microseconds since the epoch (CLOCK_REALTIME)
+ *  16  section    'length' bytes, including header and CRC32
+ */
+
+#define SECFRAME_HEADER_SIZE 16
+
+struct secframe {
+  uint16_t pid;
+  uint8_t table_id;
+  uint16_t length;
+  uint64_t timestamp;
+};
+
+static inline void secframe_write(uint8_t *h, const struct secframe *f)
+{
+  int i;
+  h[0] = 'S';
+  h[1] = 'C';
+  h[2] = f->pid >> 8;
+  h[3] = f->pid & 0xFF;
+  h[4] = f->table_id;
+  h[5] = 0;
+  h[6] = f->length >> 8;
+  h[7] = f->length & 0xFF;
+  for(i = 0; i < 8; ++i)
+    h[8 + i] = (f->timestamp >> ((7 - i) * 8)) & 0xFF;
+}
+
+/* Returns 0 on success, -1 if the magic does not match */
+static inline int secframe_read(const uint8_t *h, struct secframe *f)
+{
+  int i;
+  if(h[0] != 'S' || h[1] != 'C')
+    return -1;
+  f->pid = (h[2] << 8) | h[3];
+  f->table_id = h[4];
+  f->length = (h[6] << 8) | h[7];
+  f->timestamp = 0;
+  for(i = 0; i < 8; ++i)
+    f->timestamp = (f->timestamp << 8) | h[8 + i];
+  return 0;
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef _SECSTREAM_H_
+#define _SECSTREAM_H_
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include "secframe.h"
+#include "psi.h"
+
+// Reads concatenated sections, bare or behind secframe headers, from a file
+// descriptor through one large buffer. next() hands out views into the
+// buffer that stay valid until the following call.
+//
+// Sections with an impossible length or a bad CRC_32 are not returned. In a
+// bare stream that means the length field cannot be trusted either, so the
+// reader moves one byte forward and looks for the next section that passes
+// its CRC_32. A framed stream is resynced the same way when a frame header
+// is broken or does not match the section behind it.
+class SectionStream {
+public:
+	SectionStream(int fd, bool framed = false, size_t buffer_size = 256*1024)
+		: fd_(fd), framed_(framed), buf_(buffer_size), begin_(0), end_(0), eof_(false), synced_(true), skipped_(0), invalid_(0) {}
+
+	// Returns false at end of input
+	bool next(const uint8_t*& section, size_t& length, secframe* frame = 0) {
+		for(;;) {
+			size_t header = framed_ ? SECFRAME_HEADER_SIZE : 0;
+
+			if(!fill(header + 3))
+				return false;
+
+			const uint8_t* p = &buf_[begin_];
+			secframe f = {0};
+
+			if(framed_ && (secframe_read(p, &f) != 0 || f.table_id != p[header]
+				|| f.length != 3 + (((p[header + 1] & 0x0F) << 8) | p[header + 2]))) {
+				if(synced_)
+					++invalid_;
+				synced_ = false;
+				skip();
+				continue;
+			}
+
+			// stuffing between sections
+			if(!framed_ && p[0] == 0xFF) {
+				++begin_;
+				continue;
+			}
+
+			size_t n = framed_ ? f.length : 3 + (((p[header + 1] & 0x0F) << 8) | p[header + 2]);
+			if(!fill(header + n)) {
+				if(framed_ || end_ == begin_)
+					return false;
+				// a corrupt length pointing past the end of input
+				skip();
+				continue;
+			}
+
+			p = &buf_[begin_];
+			// without a CRC_32 a candidate found while resyncing cannot be trusted
+			if(!valid(p + header, n) || (!synced_ && !psi_has_crc(p + header, n))) {
+				if(synced_)
+					++invalid_;
+				if(framed_ && synced_)
+					begin_ += header + n;
+				else {
+					synced_ = false;
+					skip();
+				}
+				continue;
+			}
+
+			synced_ = true;
+
+			section = p + header;
+			length = n;
+			if(frame) *frame = f;
+			begin_ += header + n;
+			return true;
+		}
+	}
+
+	// bytes read ahead but not handed out yet, 0 means next() may block
+	size_t buffered() const { return end_ - begin_; }
+
+	// bytes skipped while looking for a section boundary
+	uint64_t skipped() const { return skipped_; }
+	// places where a section was rejected for its length or CRC
+	uint64_t invalid() const { return invalid_; }
+
+	static bool valid(const uint8_t* s, size_t n) {
+		if(n < 3 || n > PSI_MAX_SECTION)
+			return false;
+		if((s[1] & 0x80) && n < 12)
+			return false;
+		return !psi_has_crc(s, n) || Crc32Mpeg::check(s, n);
+	}
+
+private:
+	void skip() {
+		++begin_;
+		++skipped_;
+	}
+
+	// Makes sure at least n bytes are buffered, false on end of input
+	bool fill(size_t n) {
+		if(end_ - begin_ >= n)
+			return true;
+
+		if(begin_) {
+			memmove(&buf_[0], &buf_[begin_], end_ - begin_);
+			end_ -= begin_;
+			begin_ = 0;
+		}
+		if(buf_.size() < n)
+			buf_.resize(n);
+
+		while(end_ < n && !eof_) {
+			ssize_t r = ::read(fd_, &buf_[end_], buf_.size() - end_);
+			if(r < 0) {
+				if(errno == EINTR) continue;
+				throw std::system_error(errno, std::system_category());
+			}
+			if(r == 0)
+				eof_ = true;
+			end_ += r;
+		}
+
+		return end_ >= n;
+	}
+
+	int fd_;
+	bool framed_;
+	std::vector<uint8_t> buf_;
+	size_t begin_;
+	size_t end_;
+	bool eof_;
+	bool synced_;
+	uint64_t skipped_;
+	uint64_t invalid_;
+};
+
+#endif
@@ -0,0 +1,626 @@
+#ifndef _SECTION_H_
+#define _SECTION_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <stdexcept>
+
+#include "crc32.h"
+
+// Zero-copy views over a PSI/SI section held in a contiguous buffer.
+// Views only keep a pointer and a size; every variable length part is
+// checked against the enclosing view and a violation throws SectionError.
+// Fixed fields go through Field<>, so their offsets, masks and shifts are
+// compile-time constants.
+
+class SectionError : public std::runtime_error {
+public:
+	explicit SectionError(const char* what) : std::runtime_error(what) {}
+};
+
+template<typename T> inline T load_be(const uint8_t* p);
+
+template<> inline uint8_t load_be<uint8_t>(const uint8_t* p) {
+	return p[0];
+}
+
+template<> inline uint16_t load_be<uint16_t>(const uint8_t* p) {
+	return uint16_t((p[0] << 8) | p[1]);
+}
+
+template<> inline uint32_t load_be<uint32_t>(const uint8_t* p) {
+	return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+template<typename T, size_t Offset, unsigned Bits = sizeof(T) * 8, unsigned Shift = 0>
+struct Field {
+	static const size_t end = Offset + sizeof(T);
+
+	static T get(const uint8_t* p) {
+		return T((load_be<T>(p + Offset) >> Shift) & ((uint64_t(1) << Bits) - 1));
+	}
+};
+
+class ByteView {
+public:
+	ByteView() : b_(0), n_(0) {}
+	ByteView(const uint8_t* b, size_t n) : b_(b), n_(n) {}
+
+	const uint8_t* data() const { return b_; }
+	size_t size() const { return n_; }
+	bool empty() const { return n_ == 0; }
+
+	void need(size_t n) const {
+		if(n > n_) throw SectionError("section: field out of bounds");
+	}
+
+	template<typename T>
+	T get(size_t off) const {
+		need(off + sizeof(T));
+		return load_be<T>(b_ + off);
+	}
+
+	ByteView sub(size_t off) const {
+		need(off);
+		return ByteView(b_ + off, n_ - off);
+	}
+
+	ByteView sub(size_t off, size_t n) const {
+		need(off + n);
+		return ByteView(b_ + off, n);
+	}
+
+private:
+	const uint8_t* b_;
+	size_t n_;
+};
+
+// Entries laid out back to back, T::length() tells the size of the next one
+template<typename T>
+class Loop {
+public:
+	explicit Loop(ByteView v) : v_(v) {}
+
+	class iterator {
+	public:
+		explicit iterator(ByteView rest) : rest_(rest), len_(rest.empty() ? 0 : T::length(rest)) {}
+
+		T operator * () const { return T(rest_.sub(0, len_)); }
+
+		iterator& operator ++ () {
+			rest_ = rest_.sub(len_);
+			len_ = rest_.empty() ? 0 : T::length(rest_);
+			return *this;
+		}
+
+		bool operator != (iterator const& i) const { return rest_.size() != i.rest_.size(); }
+
+	private:
+		ByteView rest_;
+		size_t len_;
+	};
+
+	iterator begin() const { return iterator(v_); }
+	iterator end() const { return iterator(v_.sub(v_.size())); }
+
+	bool empty() const { return v_.empty(); }
+	ByteView view() const { return v_; }
+
+private:
+	ByteView v_;
+};
+
+class Descriptor {
+public:
+	explicit Descriptor(ByteView v) : v_(v) {}
+
+	static size_t length(ByteView v) {
+		size_t n = 2 + v.get<uint8_t>(1);
+		v.need(n);
+		return n;
+	}
+
+	uint8_t tag() const { return Field<uint8_t, 0>::get(v_.data()); }
+	uint8_t length() const { return Field<uint8_t, 1>::get(v_.data()); }
+	ByteView body() const { return v_.sub(2); }
+	ByteView view() const { return v_; }
+
+private:
+	ByteView v_;
+};
+
+typedef Loop<Descriptor> DescriptorLoop;
+
+// Common part of all sections. The view is cut to section_length.
+class Section {
+public:
+	explicit Section(ByteView v) : v_(v) {
+		v_.need(3);
+		v_ = v_.sub(0, 3 + section_length());
+	}
+
+	uint8_t table_id() const { return Field<uint8_t, 0>::get(v_.data()); }
+	bool section_syntax_indicator() const { return Field<uint8_t, 1, 1, 7>::get(v_.data()); }
+	uint16_t section_length() const { return Field<uint16_t, 1, 12>::get(v_.data()); }
+
+	ByteView view() const { return v_; }
+	bool crc_ok() const { return Crc32Mpeg::check(v_.data(), v_.size()); }
+
+protected:
+	ByteView v_;
+};
+
+// Section with the long header: table_id_extension to last_section_number
+class LongSection : public Section {
+public:
+	static const size_t header_length = 8;
+
+	explicit LongSection(ByteView v, size_t fixed = header_length) : Section(v) {
+		v_.need(fixed + 4);
+	}
+
+	uint16_t table_id_extension() const { return Field<uint16_t, 3>::get(v_.data()); }
+	uint8_t version() const { return Field<uint8_t, 5, 5, 1>::get(v_.data()); }
+	bool current_next() const { return Field<uint8_t, 5, 1>::get(v_.data()); }
+	uint8_t section_number() const { return Field<uint8_t, 6>::get(v_.data()); }
+	uint8_t last_section_number() const { return Field<uint8_t, 7>::get(v_.data()); }
+	uint32_t crc() const { return load_be<uint32_t>(v_.data() + v_.size() - 4); }
+
+protected:
+	// Bytes from 'off' up to the CRC
+	ByteView body(size_t off) const { return v_.sub(off, v_.size() - 4 - off); }
+};
+
+/* PAT */
+
+class PatProgram {
+public:
+	explicit PatProgram(ByteView v) : v_(v) {}
+
+	static size_t length(ByteView v) { v.need(4); return 4; }
+
+	uint16_t program_number() const { return Field<uint16_t, 0>::get(v_.data()); }
+	uint16_t pid() const { return Field<uint16_t, 2, 13>::get(v_.data()); }
+
+private:
+	ByteView v_;
+};
+
+class PatSection : public LongSection {
+public:
+	explicit PatSection(ByteView v) : LongSection(v) {}
+
+	uint16_t transport_stream_id() const { return table_id_extension(); }
+
+	// a trailing partial entry is ignored
+	Loop<PatProgram> programs() const {
+		ByteView b = body(header_length);
+		return Loop<PatProgram>(b.sub(0, b.size() & ~size_t(3)));
+	}
+};
+
+/* PMT */
+
+class PmtStream {
+public:
+	explicit PmtStream(ByteView v) : v_(v) {}
+
+	static size_t length(ByteView v) {
+		size_t n = 5 + (v.get<uint16_t>(3) & 0x3FF);
+		v.need(n);
+		return n;
+	}
+
+	uint8_t stream_type() const { return Field<uint8_t, 0>::get(v_.data()); }
+	uint16_t pid() const { return Field<uint16_t, 1, 13>::get(v_.data()); }
+	DescriptorLoop descriptors() const { return DescriptorLoop(v_.sub(5)); }
+
+private:
+	ByteView v_;
+};
+
+class PmtSection : public LongSection {
+public:
+	static const size_t fixed_length = 12;
+
+	explicit PmtSection(ByteView v) : LongSection(v, fixed_length) {}
+
+	uint16_t program_number() const { return table_id_extension(); }
+	uint16_t pcr_pid() const { return Field<uint16_t, 8, 13>::get(v_.data()); }
+	uint16_t program_info_length() const { return Field<uint16_t, 10, 10>::get(v_.data()); }
+
+	DescriptorLoop descriptors() const { return DescriptorLoop(body(fixed_length).sub(0, program_info_length())); }
+	Loop<PmtStream> streams() const { return Loop<PmtStream>(body(fixed_length).sub(program_info_length())); }
+};
+
+/* NIT */
+
+class NitTransport {
+public:
+	explicit NitTransport(ByteView v) : v_(v) {}
+
+	static size_t length(ByteView v) {
+		size_t n = 6 + (v.get<uint16_t>(4) & 0xFFF);
+		v.need(n);
+		return n;
+	}
+
+	uint16_t transport_stream_id() const { return Field<uint16_t, 0>::get(v_.data()); }
+	uint16_t original_network_id() const { return Field<uint16_t, 2>::get(v_.data()); }
+	DescriptorLoop descriptors() const { return DescriptorLoop(v_.sub(6)); }
+
+private:
+	ByteView v_;
+};
+
+class NitSection : public LongSection {
+public:
+	static const size_t fixed_length = 10;
+
+	explicit NitSection(ByteView v) : LongSection(v, fixed_length) {}
+
+	uint16_t network_id() const { return table_id_extension(); }
+	uint16_t network_descriptors_length() const { return Field<uint16_t, 8, 12>::get(v_.data()); }
+
+	DescriptorLoop descriptors() const { return DescriptorLoop(body(fixed_length).sub(0, network_descriptors_length())); }
+
+	Loop<NitTransport> transports() const {
+		ByteView b = body(fixed_length).sub(network_descriptors_length());
+		return Loop<NitTransport>(b.sub(2, b.get<uint16_t>(0) & 0xFFF));
+	}
+};
+
+/* SDT */
+
+class SdtService {
+public:
+	explicit SdtService(ByteView v) : v_(v) {}
+
+	static size_t length(ByteView v) {
+		size_t n = 5 + (v.get<uint16_t>(3) & 0xFFF);
+		v.need(n);
+		return n;
+	}
+
+	uint16_t service_id() const { return Field<uint16_t, 0>::get(v_.data()); }
+	bool eit_schedule() const { return Field<uint8_t, 2, 1, 1>::get(v_.data()); }
+	bool eit_present_following() const { return Field<uint8_t, 2, 1>::get(v_.data()); }
+	uint8_t running_status() const { return Field<uint16_t, 3, 3, 13>::get(v_.data()); }
+	bool free_ca_mode() const { return Field<uint16_t, 3, 1, 12>::get(v_.data()); }
+	DescriptorLoop descriptors() const { return DescriptorLoop(v_.sub(5)); }
+
+private:
+	ByteView v_;
+};
+
+class SdtSection : public LongSection {
+public:
+	static const size_t fixed_length = 11;
+
+	explicit SdtSection(ByteView v) : LongSection(v, fixed_length) {}
+
+	uint16_t transport_stream_id() const { return table_id_extension(); }
+	uint16_t original_network_id() const { return Field<uint16_t, 8>::get(v_.data()); }
+	Loop<SdtService> services() const { return Loop<SdtService>(body(fixed_length)); }
+};
+
+/* EIT */
+
+class EitEvent {
+public:
+	explicit EitEvent(ByteView v) : v_(v) {}
+
+	static size_t length(ByteView v) {
+		size_t n = 12 + (v.get<uint16_t>(10) & 0xFFF);
+		v.need(n);
+		return n;
+	}
+
+	uint16_t event_id() const { return Field<uint16_t, 0>::get(v_.data()); }
+	uint16_t start_mjd() const { return Field<uint16_t, 2>::get(v_.data()); }
+	// hours, minutes and seconds as 6 BCD digits
+	uint32_t start_bcd() const { return (Field<uint32_t, 2>::get(v_.data()) << 8 | v_.data()[6]) & 0xFFFFFF; }
+	uint32_t duration_bcd() const { return Field<uint32_t, 6>::get(v_.data()) & 0xFFFFFF; }
+	uint8_t running_status() const { return Field<uint16_t, 10, 3, 13>::get(v_.data()); }
+	bool free_ca_mode() const { return Field<uint16_t, 10, 1, 12>::get(v_.data()); }
+	DescriptorLoop descriptors() const { return DescriptorLoop(v_.sub(12)); }
+
+private:
+	ByteView v_;
+};
+
+class EitSection : public LongSection {
+public:
+	static const size_t fixed_length = 14;
+
+	explicit EitSection(ByteView v) : LongSection(v, fixed_length) {}
+
+	uint16_t service_id() const { return table_id_extension(); }
+	uint16_t transport_stream_id() const { return Field<uint16_t, 8>::get(v_.data()); }
+	uint16_t original_network_id() const { return Field<uint16_t, 10>::get(v_.data()); }
+	uint8_t segment_last_section_number() const { return Field<uint8_t, 12>::get(v_.data()); }
+	uint8_t last_table_id() const { return Field<uint8_t, 13>::get(v_.data()); }
+	Loop<EitEvent> events() const { return Loop<EitEvent>(body(fixed_length)); }
+};
+
+/* descriptors decoded by the tools */
+
+// 0x48
+class ServiceDescriptor {
+public:
+	explicit ServiceDescriptor(Descriptor const& d) : v_(d.body()) {
+		provider_ = v_.sub(2, v_.get<uint8_t>(1));
+		name_ = v_.sub(3 + provider_.size(), v_.get<uint8_t>(2 + provider_.size()));
+	}
+
+	uint8_t service_type() const { return v_.get<uint8_t>(0); }
+	ByteView provider_name() const { return provider_; }
+	ByteView service_name() const { return name_; }
+
+private:
+	ByteView v_;
+	ByteView provider_;
+	ByteView name_;
+};
+
+// 0x4d
+class ShortEventDescriptor {
+public:
+	explicit ShortEventDescriptor(Descriptor const& d) : v_(d.body()) {
+		name_ = v_.sub(4, v_.get<uint8_t>(3));
+		text_ = v_.sub(5 + name_.size(), v_.get<uint8_t>(4 + name_.size()));
+	}
+
+	ByteView language() const { return v_.sub(0, 3); }
+	ByteView event_name() const { return name_; }
+	ByteView text() const { return text_; }
+
+private:
+	ByteView v_;
+	ByteView name_;
+	ByteView text_;
+};
+
+// 0x43
+class SatelliteDeliveryDescriptor {
+public:
+	explicit SatelliteDeliveryDescriptor(Descriptor const& d) : v_(d.body()) {
+		v_.need(11);
+	}
+
+	// BCD coded
+	uint32_t frequency() const { return Field<uint32_t, 0>::get(v_.data()); }
+	uint16_t orbital_position() const { return Field<uint16_t, 4>::get(v_.data()); }
+	uint8_t west_east_flag() const { return Field<uint8_t, 6, 1, 7>::get(v_.data()); }
+	uint8_t polarization() const { return Field<uint8_t, 6, 2, 5>::get(v_.data()); }
+	uint8_t modulation() const { return Field<uint8_t, 6, 5>::get(v_.data()); }
+	// BCD coded
+	uint32_t symbol_rate() const { return Field<uint32_t, 7, 28, 4>::get(v_.data()); }
+	uint8_t fec_inner() const { return Field<uint32_t, 7, 4>::get(v_.data()); }
+
+private:
+	ByteView v_;
+};
+
+// 0x5a
+class TerrestrialDeliveryDescriptor {
+public:
+	explicit TerrestrialDeliveryDescriptor(Descriptor const& d) : v_(d.body()) {
+		v_.need(11);
+	}
+
+	uint32_t centre_frequency() const { return Field<uint32_t, 0>::get(v_.data()); }
+	uint8_t bandwidth() const { return Field<uint8_t, 4, 3, 5>::get(v_.data()); }
+	uint8_t constellation() const { return Field<uint8_t, 5, 2, 6>::get(v_.data()); }
+	uint8_t hierarchy_information() const { return Field<uint8_t, 5, 3, 3>::get(v_.data()); }
+	uint8_t code_rate_hp() const { return Field<uint8_t, 5, 3>::get(v_.data()); }
+	uint8_t code_rate_lp() const { return Field<uint8_t, 6, 3, 5>::get(v_.data()); }
+	// 2 bits; parse-nit before the views printed 3, with the low bit of code_rate-LP_stream
+	uint8_t guard_interval() const { return Field<uint8_t, 6, 2, 3>::get(v_.data()); }
+	uint8_t transmission_mode() const { return Field<uint8_t, 6, 2, 1>::get(v_.data()); }
+	bool other_frequency_flag() const { return Field<uint8_t, 6, 1>::get(v_.data()); }
+
+private:
+	ByteView v_;
+};
+
+// 0x09
+class CaDescriptor {
+public:
+	explicit CaDescriptor(Descriptor const& d) : v_(d.body()) {
+		v_.need(4);
+	}
+
+	uint16_t ca_system_id() const { return Field<uint16_t, 0>::get(v_.data()); }
+	uint16_t ca_pid() const { return Field<uint16_t, 2, 13>::get(v_.data()); }
+	ByteView private_data() const { return v_.sub(4); }
+
+private:
+	ByteView v_;
+};
+
+// 0x4e, item_description and item pairs
+class ExtendedEventItem {
+public:
+	explicit ExtendedEventItem(ByteView v) : v_(v) {}
+
+	static size_t length(ByteView v) {
+		size_t n = 1 + v.get<uint8_t>(0);
+		n += 1 + v.get<uint8_t>(n);
+		v.need(n);
+		return n;
+	}
+
+	ByteView description() const { return v_.sub(1, v_.get<uint8_t>(0)); }
+	ByteView item() const { return v_.sub(2 + v_.get<uint8_t>(0)); }
+
+private:
+	ByteView v_;
+};
+
+// 0x4e
+class ExtendedEventDescriptor {
+public:
+	explicit ExtendedEventDescriptor(Descriptor const& d) : v_(d.body()) {
+		items_ = v_.sub(5, v_.get<uint8_t>(4));
+		text_ = v_.sub(6 + items_.size(), v_.get<uint8_t>(5 + items_.size()));
+	}
+
+	uint8_t descriptor_number() const { return v_.get<uint8_t>(0) >> 4; }
+	uint8_t last_descriptor_number() const { return v_.get<uint8_t>(0) & 0x0F; }
+	ByteView language() const { return v_.sub(1, 3); }
+	Loop<ExtendedEventItem> items() const { return Loop<ExtendedEventItem>(items_); }
+	ByteView text() const { return text_; }
+
+private:
+	ByteView v_;
+	ByteView items_;
+	ByteView text_;
+};
+
+// 0x50
+class ComponentDescriptor {
+public:
+	explicit ComponentDescriptor(Descriptor const& d) : v_(d.body()) {
+		v_.need(6);
+	}
+
+	uint8_t stream_content_ext() const { return Field<uint8_t, 0, 4, 4>::get(v_.data()); }
+	uint8_t stream_content() const { return Field<uint8_t, 0, 4>::get(v_.data()); }
+	uint8_t component_type() const { return Field<uint8_t, 1>::get(v_.data()); }
+	uint8_t component_tag() const { return Field<uint8_t, 2>::get(v_.data()); }
+	ByteView language() const { return v_.sub(3, 3); }
+	ByteView text() const { return v_.sub(6); }
+
+private:
+	ByteView v_;
+};
+
+// 0x54, one genre
+class ContentItem {
+public:
+	explicit ContentItem(ByteView v) : v_(v) {}
+
+	static size_t length(ByteView v) {
+		v.need(2);
+		return 2;
+	}
+
+	uint8_t level_1() const { return Field<uint8_t, 0, 4, 4>::get(v_.data()); }
+	uint8_t level_2() const { return Field<uint8_t, 0, 4>::get(v_.data()); }
+	uint8_t user_byte() const { return Field<uint8_t, 1>::get(v_.data()); }
+
+private:
+	ByteView v_;
+};
+
+// 0x54
+class ContentDescriptor {
+public:
+	explicit ContentDescriptor(Descriptor const& d) : v_(d.body()) {}
+
+	Loop<ContentItem> items() const { return Loop<ContentItem>(v_); }
+
+private:
+	ByteView v_;
+};
+
+// 0x5f, applies to the descriptors after it in the same loop
+class PrivateDataSpecifierDescriptor {
+public:
+	explicit PrivateDataSpecifierDescriptor(Descriptor const& d) : v_(d.body()) {
+		v_.need(4);
+	}
+
+	uint32_t private_data_specifier() const { return Field<uint32_t, 0>::get(v_.data()); }
+
+private:
+	ByteView v_;
+};
+
+// 0x83 with private_data_specifier 0x28 (EACEM), one service
+class LogicalChannel {
+public:
+	explicit LogicalChannel(ByteView v) : v_(v) {}
+
+	static size_t length(ByteView v) {
+		v.need(4);
+		return 4;
+	}
+
+	uint16_t service_id() const { return Field<uint16_t, 0>::get(v_.data()); }
+	bool visible_service_flag() const { return Field<uint8_t, 2, 1, 7>::get(v_.data()); }
+	uint16_t logical_channel_number() const { return Field<uint16_t, 2, 10>::get(v_.data()); }
+
+private:
+	ByteView v_;
+};
+
+// 0x83 with private_data_specifier 0x28 (EACEM)
+class LogicalChannelDescriptor {
+public:
+	explicit LogicalChannelDescriptor(Descriptor const& d) : v_(d.body()) {}
+
+	Loop<LogicalChannel> channels() const { return Loop<LogicalChannel>(v_); }
+
+private:
+	ByteView v_;
+};
+
+/* time */
+
+// Modified Julian Date to calendar date (EN 300 468 annex C).
+// Returns false for the undefined value used by NVOD references.
+inline bool mjd_to_date(uint16_t mjd, int& year, int& month, int& day) {
+	if(mjd >= 0xFE00) {
+		year = month = day = -1;
+		return false;
+	}
+
+	year = int((mjd - 15078.2) / 365.25);
+	month = int((mjd - 14956.1 - int(year * 365.25)) / 30.6001);
+	day = mjd - 14956 - int(year * 365.25) - int(month * 30.6001);
+	if(month == 14 || month == 15) {
+		year += 1;
+		month -= 12;
+	}
+	month -= 1;
+	year += 1900;
+	return true;
+}
+
+inline int from_bcd(uint8_t v) {
+	return v / 16 * 10 + v % 16;
+}
+
+// The lowest 'digits' BCD digits of v, as in the delivery descriptors
+inline uint32_t bcd_to_uint(uint32_t v, int digits) {
+	uint32_t r = 0;
+	for(int i = digits - 1; i >= 0; --i)
+		r = r * 10 + (v >> (i * 4) & 0xF);
+	return r;
+}
+
+// 24 bit hhmmss BCD to its parts
+inline void bcd_to_time(uint32_t bcd, int& hours, int& minutes, int& seconds) {
+	hours = from_bcd(bcd >> 16);
+	minutes = from_bcd((bcd >> 8) & 0xFF);
+	seconds = from_bcd(bcd & 0xFF);
+}
+
+// 24 bit hhmmss BCD duration in seconds
+inline uint32_t bcd_to_seconds(uint32_t bcd) {
+	int hours, minutes, seconds;
+	bcd_to_time(bcd, hours, minutes, seconds);
+	return hours * 3600 + minutes * 60 + seconds;
+}
+
+// MJD and hhmmss BCD UTC time to seconds since the epoch, -1 if undefined
+inline int64_t mjd_to_unix(uint16_t mjd, uint32_t bcd) {
+	if(mjd >= 0xFE00)
+		return -1;
+	return (int64_t(mjd) - 40587) * 86400 + bcd_to_seconds(bcd);
+}
+
+#endif
@@ -0,0 +1,445 @@
+#ifndef _SERVICESCAN_H_
+#define _SERVICESCAN_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "section.h"
+#include "record.h"
+#include "descriptors.h"
+
+// Sections of one table as they come in, until sections 0 to
+// last_section_number of one version are all there. Later versions of a
+// complete table are ignored, a scan takes the first one it gets.
+class ScanTable {
+public:
+	ScanTable() : version_(-1), last_(0), count_(0), first_(0), complete_(0), seen_(false), done_(false) {}
+
+	// True when the section completes the table
+	bool add(LongSection const& s, uint64_t now) {
+		if(done_)
+			return false;
+
+		if(!seen_) {
+			seen_ = true;
+			first_ = now;
+		}
+
+		if(s.version() != version_) {
+			version_ = s.version();
+			last_ = s.last_section_number();
+			sections_.assign(last_ + 1, std::string());
+			count_ = 0;
+		}
+
+		if(s.section_number() > last_ || !sections_[s.section_number()].empty())
+			return false;
+
+		ByteView v = s.view();
+		sections_[s.section_number()].assign(reinterpret_cast<const char*>(v.data()), v.size());
+		if(++count_ < last_ + 1u)
+			return false;
+
+		done_ = true;
+		complete_ = now;
+		return true;
+	}
+
+	bool seen() const { return seen_; }
+	bool complete() const { return done_; }
+	int version() const { return version_; }
+	unsigned sections() const { return count_; }
+	unsigned last_section_number() const { return last_; }
+	// times passed to add() with the first and the completing section
+	uint64_t first() const { return first_; }
+	uint64_t completed() const { return complete_; }
+
+	// Sections received so far, in section_number order
+	std::vector<ByteView> views() const {
+		std::vector<ByteView> r;
+		for(size_t i = 0; i < sections_.size(); ++i)
+			if(!sections_[i].empty())
+				r.push_back(ByteView(reinterpret_cast<const uint8_t*>(sections_[i].data()), sections_[i].size()));
+		return r;
+	}
+
+private:
+	std::vector<std::string> sections_;
+	int version_;
+	unsigned last_;
+	unsigned count_;
+	uint64_t first_;
+	uint64_t complete_;
+	bool seen_;
+	bool done_;
+};
+
+// A section filter the scan needs: PID and table_id
+struct ScanFilter {
+	uint16_t pid_;
+	uint8_t table_id_;
+
+	bool operator < (ScanFilter const& f) const { return pid_ < f.pid_ || (pid_ == f.pid_ && table_id_ < f.table_id_); }
+	bool operator == (ScanFilter const& f) const { return pid_ == f.pid_ && table_id_ == f.table_id_; }
+};
+
+// A table of a scan and its version, -1 if none arrived
+struct ScanVersion {
+	uint8_t table_id_;
+	uint16_t extension_;
+	int version_;
+
+	bool operator < (ScanVersion const& v) const {
+		return table_id_ < v.table_id_ || (table_id_ == v.table_id_ && extension_ < v.extension_);
+	}
+};
+
+// Collects the PSI/SI of one multiplex in a single pass: PAT, the PMT of
+// every program in it, SDT actual and NIT actual, all at the same time.
+// Whoever feeds sections asks filters() what to listen to; the set grows
+// once the PAT names the PMT PIDs and shrinks as tables complete.
+// Times passed to add() are microseconds since the scan started.
+class ServiceScan {
+public:
+	ServiceScan() : nit_pid_(0x10), invalid_(0) {}
+
+	// Returns true if filters() has changed
+	bool add(uint16_t pid, const uint8_t* s, size_t n, uint64_t now) {
+		if(n < 3)
+			return false;
+
+		try {
+			uint8_t table_id = s[0];
+			if(pid == 0x00 && table_id == 0x00) {
+				PatSection pat(ByteView(s, n));
+				if(pat.current_next() && pat_.add(pat, now)) {
+					programs();
+					return true;
+				}
+			}
+			else if(table_id == 0x02) {
+				PmtSection pmt(ByteView(s, n));
+				std::map<uint16_t, Program>::iterator i = programs_.find(pmt.program_number());
+				if(pmt.current_next() && i != programs_.end() && i->second.pid_ == pid)
+					return i->second.pmt_.add(pmt, now);
+			}
+			else if(pid == 0x11 && table_id == 0x42) {
+				SdtSection sdt(ByteView(s, n));
+				// SDT actual describes the multiplex the PAT is from
+				if(sdt.current_next() && (!pat_.seen() || sdt.transport_stream_id() == transport_stream_id()))
+					return sdt_.add(sdt, now);
+			}
+			else if(pid == nit_pid_ && table_id == 0x40) {
+				NitSection nit(ByteView(s, n));
+				if(nit.current_next())
+					return nit_.add(nit, now);
+			}
+		}
+		catch(SectionError const&) {
+			++invalid_;
+		}
+		return false;
+	}
+
+	// Filters for the tables still incomplete, sorted
+	std::vector<ScanFilter> filters() const {
+		std::vector<ScanFilter> r;
+		if(!pat_.complete())
+			r.push_back(filter(0x00, 0x00));
+		for(std::map<uint16_t, Program>::const_iterator i = programs_.begin(); i != programs_.end(); ++i)
+			if(!i->second.pmt_.complete())
+				r.push_back(filter(i->second.pid_, 0x02));
+		if(!sdt_.complete())
+			r.push_back(filter(0x11, 0x42));
+		if(!nit_.complete())
+			r.push_back(filter(nit_pid_, 0x40));
+
+		std::sort(r.begin(), r.end());
+		r.erase(std::unique(r.begin(), r.end()), r.end());
+		return r;
+	}
+
+	bool complete() const {
+		return filters().empty();
+	}
+
+	uint64_t invalid() const { return invalid_; }
+
+	// Names of the tables still incomplete, "pat pmt:101 sdt nit"
+	std::string missing() const {
+		std::string r;
+		char buf[32];
+		if(!pat_.complete())
+			r += " pat";
+		for(std::map<uint16_t, Program>::const_iterator i = programs_.begin(); i != programs_.end(); ++i) {
+			if(!i->second.pmt_.complete()) {
+				snprintf(buf, sizeof(buf), " pmt:%u", i->first);
+				r += buf;
+			}
+		}
+		if(!sdt_.complete())
+			r += " sdt";
+		if(!nit_.complete())
+			r += " nit";
+		return r.empty() ? r : r.substr(1);
+	}
+
+	uint16_t transport_stream_id() const {
+		std::vector<ByteView> v = pat_.views();
+		return v.empty() ? 0 : PatSection(v[0]).transport_stream_id();
+	}
+
+	uint16_t original_network_id() const {
+		std::vector<ByteView> v = sdt_.views();
+		return v.empty() ? 0 : SdtSection(v[0]).original_network_id();
+	}
+
+	uint16_t network_id() const {
+		std::vector<ByteView> v = nit_.views();
+		return v.empty() ? 0 : NitSection(v[0]).network_id();
+	}
+
+	// -1 until a NIT section arrived
+	int nit_version() const { return nit_.version(); }
+
+	ScanTable const& nit() const { return nit_; }
+
+	// PAT, PMTs by program_number, SDT and NIT, sorted
+	std::vector<ScanVersion> versions() const {
+		std::vector<ScanVersion> r;
+		r.push_back(version(0x00, transport_stream_id(), pat_));
+		for(std::map<uint16_t, Program>::const_iterator i = programs_.begin(); i != programs_.end(); ++i)
+			r.push_back(version(0x02, i->first, i->second.pmt_));
+		r.push_back(version(0x40, network_id(), nit_));
+		r.push_back(version(0x42, transport_stream_id(), sdt_));
+		std::sort(r.begin(), r.end());
+		return r;
+	}
+
+	// Calls f(service_id, pmt_pid, pmt, sdt) for every service of the PAT
+	// or the SDT, by service_id. 'pmt' are the PMT sections, none if the
+	// PAT does not list the service, and 'sdt' its entry in the SDT or 0.
+	template<class F>
+	void services(F& f) const {
+		std::map<uint16_t, SdtService> sdt;
+		std::vector<ByteView> sections = sdt_.views();
+		for(size_t i = 0; i < sections.size(); ++i) {
+			Loop<SdtService> services = SdtSection(sections[i]).services();
+			for(Loop<SdtService>::iterator j = services.begin(); j != services.end(); ++j)
+				sdt.insert(std::make_pair((*j).service_id(), *j));
+		}
+
+		std::vector<uint16_t> ids;
+		for(std::map<uint16_t, Program>::const_iterator i = programs_.begin(); i != programs_.end(); ++i)
+			ids.push_back(i->first);
+		for(std::map<uint16_t, SdtService>::const_iterator i = sdt.begin(); i != sdt.end(); ++i)
+			if(!programs_.count(i->first))
+				ids.push_back(i->first);
+		std::sort(ids.begin(), ids.end());
+
+		for(size_t i = 0; i < ids.size(); ++i) {
+			std::map<uint16_t, Program>::const_iterator p = programs_.find(ids[i]);
+			std::map<uint16_t, SdtService>::const_iterator s = sdt.find(ids[i]);
+			std::vector<ByteView> pmt;
+			if(p != programs_.end())
+				pmt = p->second.pmt_.views();
+			f(ids[i], p == programs_.end() ? 0 : p->second.pid_, pmt, s == sdt.end() ? 0 : &s->second);
+		}
+	}
+
+	// Calls f(pid, section, time) for every section collected, PAT first,
+	// so that feeding them to add() of a new scan rebuilds this one with
+	// the same first and complete times
+	template<class F>
+	void sections(F& f) const {
+		sections(f, 0x00, pat_);
+		for(std::map<uint16_t, Program>::const_iterator i = programs_.begin(); i != programs_.end(); ++i)
+			sections(f, i->second.pid_, i->second.pmt_);
+		sections(f, 0x11, sdt_);
+		sections(f, nit_pid_, nit_);
+	}
+
+	// The service map: PAT, PMT and SDT merged by service_id, the
+	// transports of the NIT and when each table was complete
+	template<class Out>
+	void write(Out& os, DescriptorRegistry<Out> const& descriptors) const {
+		std::string buf;
+
+		os.begin(RECORD_SCAN);
+		os.number("transport_stream_id", transport_stream_id());
+		os.number("original_network_id", original_network_id());
+		os.number("network_id", network_id());
+		os.number("nit_pid", nit_pid_);
+		os.flag("complete", complete());
+
+		os.array("services");
+		ServiceWriter<Out> w = {os, descriptors, buf};
+		services(w);
+		os.end_array();
+
+		os.array("transports");
+		std::vector<ByteView> sections = nit_.views();
+		for(size_t i = 0; i < sections.size(); ++i) {
+			Loop<NitTransport> transports = NitSection(sections[i]).transports();
+			for(Loop<NitTransport>::iterator j = transports.begin(); j != transports.end(); ++j) {
+				NitTransport ts = *j;
+				os.object();
+				os.number("transport_stream_id", ts.transport_stream_id());
+				os.number("original_network_id", ts.original_network_id());
+				descriptors.write(os, ts.descriptors(), buf);
+				os.end_object();
+			}
+		}
+		os.end_array();
+
+		os.array("tables");
+		write_table(os, "pat", 0x00, 0x00, transport_stream_id(), pat_, buf);
+		for(std::map<uint16_t, Program>::const_iterator i = programs_.begin(); i != programs_.end(); ++i)
+			write_table(os, "pmt", i->second.pid_, 0x02, i->first, i->second.pmt_, buf);
+		write_table(os, "sdt", 0x11, 0x42, transport_stream_id(), sdt_, buf);
+		write_table(os, "nit", nit_pid_, 0x40, network_id(), nit_, buf);
+		os.end_array();
+
+		os.end();
+	}
+
+private:
+	struct Program {
+		uint16_t pid_;
+		ScanTable pmt_;
+	};
+
+	static ScanFilter filter(uint16_t pid, uint8_t table_id) {
+		ScanFilter f = {pid, table_id};
+		return f;
+	}
+
+	static ScanVersion version(uint8_t table_id, uint16_t extension, ScanTable const& t) {
+		ScanVersion v = {table_id, extension, t.version()};
+		return v;
+	}
+
+	// PMT PIDs and the NIT PID from the complete PAT
+	void programs() {
+		std::vector<ByteView> sections = pat_.views();
+		for(size_t i = 0; i < sections.size(); ++i) {
+			Loop<PatProgram> programs = PatSection(sections[i]).programs();
+			for(Loop<PatProgram>::iterator j = programs.begin(); j != programs.end(); ++j) {
+				PatProgram p = *j;
+				if(p.program_number() == 0)
+					nit_pid_ = p.pid();
+				else
+					programs_[p.program_number()].pid_ = p.pid();
+			}
+		}
+	}
+
+	template<class F>
+	static void sections(F& f, uint16_t pid, ScanTable const& t) {
+		std::vector<ByteView> v = t.views();
+		for(size_t i = 0; i < v.size(); ++i)
+			f(pid, v[i], i == 0 || !t.complete() ? t.first() : t.completed());
+	}
+
+	template<class Out>
+	struct ServiceWriter {
+		Out& os_;
+		DescriptorRegistry<Out> const& descriptors_;
+		std::string& buf_;
+
+		void operator () (uint16_t id, uint16_t pmt_pid, std::vector<ByteView> const& pmt, SdtService const* s) {
+			write_service(os_, descriptors_, id, pmt_pid, pmt, s, buf_);
+		}
+	};
+
+	template<class Out>
+	static void write_service(Out& os, DescriptorRegistry<Out> const& descriptors, uint16_t id, uint16_t pmt_pid,
+		std::vector<ByteView> const& pmt, SdtService const* s, std::string& buf) {
+		os.object();
+		os.number("service_id", id);
+		os.number("pmt_pid", pmt_pid);
+
+		// absent tables leave zeros and empty strings, so every service has the same fields
+		os.number("pcr_pid", pmt.empty() ? 0 : PmtSection(pmt[0]).pcr_pid());
+
+		uint8_t type = 0;
+		std::string provider, name;
+		Descriptor d((ByteView()));
+		if(s && find_descriptor(s->descriptors(), 0x48, d)) {
+			ServiceDescriptor sd(d);
+			type = sd.service_type();
+			text(sd.provider_name(), provider);
+			text(sd.service_name(), name);
+		}
+		os.number("service_type", type);
+		os.text("provider", provider);
+		os.text("name", name);
+		os.flag("EIT_schedule_flag", s && s->eit_schedule());
+		os.flag("EIT_present_following_flag", s && s->eit_present_following());
+		os.number("running_status", s ? s->running_status() : 0);
+		os.flag("free_CA_mode", s && s->free_ca_mode());
+
+		if(pmt.empty())
+			descriptors.write(os, DescriptorLoop(ByteView()), buf);
+		else
+			descriptors.write(os, PmtSection(pmt[0]).descriptors(), buf);
+
+		os.array("streams");
+		for(size_t i = 0; i < pmt.size(); ++i) {
+			Loop<PmtStream> streams = PmtSection(pmt[i]).streams();
+			for(Loop<PmtStream>::iterator j = streams.begin(); j != streams.end(); ++j) {
+				PmtStream es = *j;
+				os.object();
+				os.number("type", es.stream_type());
+				os.number("pid", es.pid());
+				descriptors.write(os, es.descriptors(), buf);
+				os.end_object();
+			}
+		}
+		os.end_array();
+
+		os.end_object();
+	}
+
+	template<class Out>
+	static void write_table(Out& os, const char* name, uint16_t pid, uint8_t table_id, uint16_t extension, ScanTable const& t, std::string& buf) {
+		os.object();
+		buf = name;
+		os.text("table", buf);
+		os.number("pid", pid);
+		os.number("table_id", table_id);
+		os.number("table_id_extension", extension);
+		os.number("version", t.version() < 0 ? 0xFF : t.version());
+		os.number("sections", t.sections());
+		os.number("last_section_number", t.last_section_number());
+		os.flag("complete", t.complete());
+		// milliseconds since the start of the scan, 0 if never
+		os.number("first_ms", t.seen() ? t.first() / 1000 : 0);
+		os.number("complete_ms", t.complete() ? t.completed() / 1000 : 0);
+		os.end_object();
+	}
+
+	ScanTable pat_;
+	std::map<uint16_t, Program> programs_;
+	ScanTable sdt_;
+	ScanTable nit_;
+	uint16_t nit_pid_;
+	uint64_t invalid_;
+};
+
+// Descriptors mux-scan and channel-scan write with their fields in the
+// service map
+template<class Out>
+void add_scan_descriptors(DescriptorRegistry<Out>& r) {
+	r.add(0x09, write_ca_descriptor<Out>);
+	r.add(0x43, write_satellite_delivery_descriptor<Out>);
+	r.add(0x5a, write_terrestrial_delivery_descriptor<Out>);
+	r.add(0x28, 0x83, write_logical_channel_descriptor<Out>);
+}
+
+#endif
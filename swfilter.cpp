@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <stdint.h>
+#include <linux/dvb/dmx.h>
+
+#include <vector>
+
+#include "secfilter.h"
+#include "secstream.h"
+
+static volatile sig_atomic_t g_stop = 0;
+
+void sighandler(int n) {
+	g_stop = 1;
+}
+
+void usage() {
+	fprintf(stderr, "usage: swfilter [-d device_name -p pid] [-F] [-f rules_file] [filter[:mask[:mode]] ...]\n"
+		"\tsections come from one pass-all filter on the pid, or from stdin (-F: framed by sec-collect)\n"
+		"\tmatching sections are written to stdout in the input format\n");
+	exit(1);
+}
+
+int parse_hex(const char* s, size_t len, uint8_t* out) {
+	if(len % 2 || len > DMX_FILTER_SIZE * 2)
+		return -1;
+	for(size_t i = 0; i < len / 2; ++i) {
+		int v;
+		if(1 != sscanf(s + i * 2, "%2x", &v))
+			return -1;
+		out[i] = v;
+	}
+	return 0;
+}
+
+int parse_rule(const char* spec, SectionFilter& f) {
+	memset(&f, 0, sizeof(f));
+
+	const char* m = strchr(spec, ':');
+	const char* o = m ? strchr(m + 1, ':') : 0;
+	size_t flen = m ? m - spec : strlen(spec);
+
+	if(parse_hex(spec, flen, f.filter_) != 0)
+		return -1;
+
+	if(m) {
+		if(parse_hex(m + 1, o ? o - m - 1 : strlen(m + 1), f.mask_) != 0)
+			return -1;
+	}
+	else
+		memset(f.mask_, 0xFF, flen / 2);
+
+	if(o && parse_hex(o + 1, strlen(o + 1), f.mode_) != 0)
+		return -1;
+
+	return 0;
+}
+
+// A section from the demux, or from the stream when reading stdin; false at
+// the end of input, on a read error or once SIGINT or SIGTERM came in
+bool next_section(int fd, SectionStream* in, std::vector<uint8_t>& buf, const uint8_t*& s, size_t& n, uint64_t& overflows) {
+	if(in)
+		return in->next(s, n);
+
+	// a section filter returns one section per read
+	for(;;) {
+		ssize_t r = read(fd, &buf[0], buf.size());
+		if(r < 0) {
+			if(errno == EOVERFLOW) {
+				++overflows;
+				continue;
+			}
+			if(errno == EINTR) {
+				if(g_stop)
+					return false;
+				continue;
+			}
+			perror("read");
+			return false;
+		}
+		if(r < 3)
+			return false;
+		s = &buf[0];
+		n = r;
+		return true;
+	}
+}
+
+bool write_all(std::vector<uint8_t> const& out) {
+	for(size_t w = 0; w < out.size();) {
+		ssize_t n = write(STDOUT_FILENO, &out[w], out.size() - w);
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			perror("write");
+			return false;
+		}
+		w += n;
+	}
+	return true;
+}
+
+double now() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+	const char* device = 0;
+	int pid = -1;
+	bool framed = false;
+	SectionFilterSet rules;
+
+	int opt;
+	while((opt = getopt(argc, argv, "d:p:Ff:")) != -1) {
+		switch(opt) {
+		case 'd': device = optarg; break;
+		case 'p': pid = strtol(optarg, 0, 0); break;
+		case 'F': framed = true; break;
+		case 'f': {
+			FILE* f = fopen(optarg, "r");
+			if(!f) {
+				perror("failed to open rules file");
+				return 1;
+			}
+			char line[256];
+			while(fgets(line, sizeof(line), f)) {
+				line[strcspn(line, " \t\r\n#")] = 0;
+				if(!line[0])
+					continue;
+				SectionFilter r;
+				if(parse_rule(line, r) != 0) {
+					fprintf(stderr, "invalid rule %s\n", line);
+					return 1;
+				}
+				rules.add(r);
+			}
+			fclose(f);
+			break;
+		}
+		default: usage();
+		}
+	}
+
+	for(int i = optind; i < argc; ++i) {
+		SectionFilter r;
+		if(parse_rule(argv[i], r) != 0) {
+			fprintf(stderr, "invalid rule %s\n", argv[i]);
+			return 1;
+		}
+		rules.add(r);
+	}
+
+	if(rules.size() == 0 || (device != 0) != (pid >= 0))
+		usage();
+
+	int fd = STDIN_FILENO;
+	if(device) {
+		if(framed)
+			usage();
+
+		fd = open(device, O_RDWR);
+		if(fd < 0) {
+			perror("failed to open demuxer");
+			return 1;
+		}
+
+		if(ioctl(fd, DMX_SET_BUFFER_SIZE, 1024*1024) != 0) {
+			fprintf(stderr, "failed to set buffer size\n");
+			return 1;
+		}
+
+		// one hardware filter passes every section of the pid
+		dmx_sct_filter_params params;
+		memset(&params, 0, sizeof(params));
+		params.pid = pid;
+		params.flags = DMX_IMMEDIATE_START | DMX_CHECK_CRC;
+
+		if(ioctl(fd, DMX_SET_FILTER, &params) != 0) {
+			fprintf(stderr, "failed to set filter\n");
+			return 1;
+		}
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sighandler;
+	sigaction(SIGTERM, &sa, 0);
+	sigaction(SIGINT, &sa, 0);
+
+	SectionStream in(fd, framed);
+	std::vector<uint8_t> buf(PSI_MAX_SECTION);
+	uint64_t overflows = 0;
+	std::vector<size_t> ids;
+	std::vector<uint8_t> out;
+	double match_time = 0;
+	double start = now();
+
+	const uint8_t* s;
+	size_t n;
+	while(!g_stop && next_section(fd, device ? 0 : &in, buf, s, n, overflows)) {
+		ids.clear();
+
+		double t = now();
+		bool hit = rules.match(s, n, ids);
+		match_time += now() - t;
+
+		if(hit) {
+			const uint8_t* b = framed ? s - SECFRAME_HEADER_SIZE : s;
+			out.insert(out.end(), b, s + n);
+		}
+
+		if(out.size() >= 64*1024 || (device && !out.empty())) {
+			if(!write_all(out))
+				break;
+			out.clear();
+		}
+	}
+
+	write_all(out);
+
+	SectionFilterStats const& st = rules.stats();
+	double total = now() - start;
+	fprintf(stderr, "swfilter: %zu rules, %llu sections, %llu bytes, %llu matches, %.2f compares/section, "
+		"%.0f ns/section matching, %.0f sections/s, %.3f MB/s, %llu overflows\n",
+		rules.size(), (unsigned long long)st.sections_, (unsigned long long)st.bytes_, (unsigned long long)st.matches_,
+		st.sections_ ? double(st.compares_) / st.sections_ : 0.0,
+		st.sections_ ? match_time * 1e9 / st.sections_ : 0.0,
+		total > 0 ? st.sections_ / total : 0.0, total > 0 ? st.bytes_ / total / 1e6 : 0.0, (unsigned long long)overflows);
+
+	return 0;
+}
@@ -0,0 +1,317 @@
+#ifndef _TABLES_H_
+#define _TABLES_H_
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <exception>
+#include <string>
+
+#include "section.h"
+#include "secstream.h"
+#include "secdedup.h"
+#include "secdiff.h"
+#include "json.h"
+#include "record.h"
+#include "descriptors.h"
+
+// One record per section, as parse-pat, parse-pmt, parse-nit, parse-sdt
+// and parse-eit write them. sec-bench and the harnesses in fuzz/ run the
+// same writers.
+
+/* PAT */
+
+template<class Out>
+void write_program(Out& os, PatProgram const& p) {
+	os.object();
+	os.number("program", p.program_number());
+	os.number("pid", p.pid());
+	os.end_object();
+}
+
+template<class Out>
+void write_pat(Out& os, PatSection const& pat) {
+	os.begin(RECORD_PAT);
+	os.number("tableid", pat.table_id());
+	os.number("streamid", pat.transport_stream_id());
+	os.number("version", pat.version());
+	os.number("number", pat.section_number());
+	os.number("lastnumber", pat.last_section_number());
+
+	os.array("programs");
+	Loop<PatProgram> programs = pat.programs();
+	for(Loop<PatProgram>::iterator i = programs.begin(); i != programs.end(); ++i)
+		write_program(os, *i);
+	os.end_array();
+
+	os.end();
+}
+
+/* PMT */
+
+// Descriptors parse-pmt prints with their fields, the others only by tag
+template<class Out>
+void add_pmt_descriptors(DescriptorRegistry<Out>& r) {
+	r.add(0x09, write_ca_descriptor<Out>);
+}
+
+template<class Out>
+void write_stream(Out& os, PmtStream const& es, DescriptorRegistry<Out> const& descriptors, std::string& buf) {
+	os.object();
+	os.number("type", es.stream_type());
+	os.number("pid", es.pid());
+	descriptors.write(os, es.descriptors(), buf);
+	os.end_object();
+}
+
+template<class Out>
+void write_pmt(Out& os, PmtSection const& pmt, DescriptorRegistry<Out> const& descriptors) {
+	std::string buf;
+
+	os.begin(RECORD_PMT);
+	os.number("tableid", pmt.table_id());
+	os.number("program_number", pmt.program_number());
+	os.number("version", pmt.version());
+	os.number("number", pmt.section_number());
+	os.number("lastnumber", pmt.last_section_number());
+	os.number("pcrpid", pmt.pcr_pid());
+	descriptors.write(os, pmt.descriptors(), buf);
+
+	os.array("streams");
+	Loop<PmtStream> streams = pmt.streams();
+	for(Loop<PmtStream>::iterator i = streams.begin(); i != streams.end(); ++i)
+		write_stream(os, *i, descriptors, buf);
+	os.end_array();
+
+	os.end();
+}
+
+/* NIT */
+
+// Descriptors parse-nit prints with their fields, the others only by tag
+template<class Out>
+void add_nit_descriptors(DescriptorRegistry<Out>& r) {
+	r.add(0x43, write_satellite_delivery_descriptor<Out>);
+	r.add(0x5a, write_terrestrial_delivery_descriptor<Out>);
+	r.add(0x28, 0x83, write_logical_channel_descriptor<Out>);
+}
+
+template<class Out>
+void write_transport(Out& os, NitTransport const& ts, DescriptorRegistry<Out> const& descriptors, std::string& buf) {
+	os.object();
+	os.number("transport_stream_id", ts.transport_stream_id());
+	os.number("original_network_id", ts.original_network_id());
+	descriptors.write(os, ts.descriptors(), buf);
+	os.end_object();
+}
+
+template<class Out>
+void write_nit(Out& os, NitSection const& nit, DescriptorRegistry<Out> const& descriptors) {
+	std::string buf;
+
+	os.begin(RECORD_NIT);
+	os.number("tableid", nit.table_id());
+	os.number("network_id", nit.network_id());
+	os.number("version", nit.version());
+	os.number("number", nit.section_number());
+	os.number("lastnumber", nit.last_section_number());
+	descriptors.write(os, nit.descriptors(), buf);
+
+	os.array("streams");
+	Loop<NitTransport> transports = nit.transports();
+	for(Loop<NitTransport>::iterator i = transports.begin(); i != transports.end(); ++i)
+		write_transport(os, *i, descriptors, buf);
+	os.end_array();
+
+	os.end();
+}
+
+/* SDT */
+
+// Descriptors parse-sdt prints with their fields, the others only by tag
+template<class Out>
+void add_sdt_descriptors(DescriptorRegistry<Out>& r) {
+	r.add(0x48, write_service_descriptor<Out>);
+}
+
+template<class Out>
+void write_service(Out& os, SdtService const& service, DescriptorRegistry<Out> const& descriptors, std::string& buf) {
+	os.object();
+	os.number("service", service.service_id());
+	os.flag("EIT_schedule_flag", service.eit_schedule());
+	os.flag("EIT_present_followin_flag", service.eit_present_following());
+	descriptors.write(os, service.descriptors(), buf);
+	os.end_object();
+}
+
+template<class Out>
+void write_sdt(Out& os, SdtSection const& sdt, DescriptorRegistry<Out> const& descriptors) {
+	std::string buf;
+
+	os.begin(RECORD_SDT);
+	os.number("tableid", sdt.table_id());
+	os.number("streamid", sdt.transport_stream_id());
+	os.number("version", sdt.version());
+	os.number("number", sdt.section_number());
+	os.number("lastnumber", sdt.last_section_number());
+	os.number("original_network_id", sdt.original_network_id());
+
+	os.array("services");
+	Loop<SdtService> services = sdt.services();
+	for(Loop<SdtService>::iterator i = services.begin(); i != services.end(); ++i)
+		write_service(os, *i, descriptors, buf);
+	os.end_array();
+
+	os.end();
+}
+
+/* EIT */
+
+// Descriptors parse-eit prints with their fields, the others only by tag
+template<class Out>
+void add_eit_descriptors(DescriptorRegistry<Out>& r) {
+	r.add(0x4d, write_short_event_descriptor<Out>);
+	r.add(0x4e, write_extended_event_descriptor<Out>);
+	r.add(0x50, write_component_descriptor<Out>);
+	r.add(0x54, write_content_descriptor<Out>);
+}
+
+template<class Out>
+void write_eit(Out& os, EitSection const& eit, DescriptorRegistry<Out> const& descriptors) {
+	std::string buf;
+
+	os.begin(RECORD_EIT);
+	os.number("table_id", eit.table_id());
+	os.number("service_id", eit.service_id());
+	os.number("version", eit.version());
+	os.number("number", eit.section_number());
+	os.number("lastnumber", eit.last_section_number());
+	os.number("transport_stream_id", eit.transport_stream_id());
+	os.number("original_network_id", eit.original_network_id());
+	os.number("segment_last_section_number", eit.segment_last_section_number());
+	os.number("last_table_id", eit.last_table_id());
+
+	os.array("events");
+	Loop<EitEvent> events = eit.events();
+	for(Loop<EitEvent>::iterator i = events.begin(); i != events.end(); ++i) {
+		EitEvent event = *i;
+
+		os.object();
+		os.number("event_id", event.event_id());
+		os.time("start_time", event.start_mjd(), event.start_bcd());
+		// no duration without a start
+		os.duration("duration", event.duration_bcd(), event.start_mjd() < 0xFE00);
+		os.number("running_status", event.running_status());
+		os.flag("free_ca_mode", event.free_ca_mode());
+		descriptors.write(os, event.descriptors(), buf);
+		os.end_object();
+	}
+	os.end_array();
+
+	os.end();
+}
+
+/* All */
+
+// Every descriptor some tool prints with its fields
+template<class Out>
+void add_all_descriptors(DescriptorRegistry<Out>& r) {
+	add_pmt_descriptors(r);
+	add_nit_descriptors(r);
+	add_sdt_descriptors(r);
+	add_eit_descriptors(r);
+}
+
+/* Tools */
+
+// main() of parse-pat, parse-pmt, parse-nit and parse-sdt, 'name' the tool.
+// Table<Out> is what differs between them:
+//
+//	static bool wanted(uint8_t table_id)
+//	void write(Out& os, Section const& s)
+//	bool diff(JsonWriter& os, TableDiff& diff, Section const& s), for -c,
+//	false if nothing changed; only Table<JsonRecord> needs it
+template<class Section, template<class> class Table>
+int parse_table(int argc, char* argv[], const char* name) {
+	bool framed = false;
+	bool unique = false;
+	bool binary = false;
+	bool changes = false;
+
+	int opt;
+	while((opt = getopt(argc, argv, "Fdcb")) != -1) {
+		switch(opt) {
+		case 'F': framed = true; break;
+		case 'd': unique = true; break;
+		case 'b': binary = true; break;
+		case 'c': changes = true; break;
+		default:
+			fprintf(stderr, "usage: %s [-F] [-d] [-c | -b] < sections\n"
+				"\t-F\tinput is framed by sec-collect or ts2sec -F\n"
+				"\t-d\tprint repeated sections only once\n"
+				"\t-c\tprint only what changed since the last section with the same key\n"
+				"\t-b\tbinary records instead of JSON, see record.h\n", name);
+			return 1;
+		}
+	}
+	if(binary && changes) {
+		fprintf(stderr, "%s: -b and -c cannot be combined\n", name);
+		return 1;
+	}
+
+	SectionStream in(STDIN_FILENO, framed);
+	SectionDedup dedup;
+	TableDiff diff;
+	const uint8_t* s;
+	size_t n;
+	secframe f = {0};
+
+	JsonWriter out;
+	JsonRecord json(out);
+	BinaryRecord bin(out);
+	Table<JsonRecord> json_table;
+	Table<BinaryRecord> bin_table;
+
+	while(out.good() && in.next(s, n, &f)) {
+		if(!Table<JsonRecord>::wanted(s[0]))
+			continue;
+		if(unique && !dedup.is_new(f.pid, s, n))
+			continue;
+
+		size_t mark = out.size();
+		try {
+			if(binary)
+				bin_table.write(bin, Section(ByteView(s, n)));
+			else if(!changes) {
+				json_table.write(json, Section(ByteView(s, n)));
+				out << '\n';
+			}
+			else if(json_table.diff(out, diff, Section(ByteView(s, n))))
+				out << '\n';
+		}
+		catch(std::exception const& e) {
+			out.truncate(mark);
+			fprintf(stderr, "%s: skipping section: %s\n", name, e.what());
+		}
+
+		// write in large blocks, but do not hold records back while waiting for input
+		out.flush(in.buffered() == 0);
+	}
+
+	if(unique) {
+		SectionDedupStats const& st = dedup.stats();
+		fprintf(stderr, "%s: %llu repeated sections skipped, %llu passed\n", name,
+			(unsigned long long)st.hits_, (unsigned long long)(st.misses_ + st.uncached_));
+	}
+
+	if(changes)
+		fprintf(stderr, "%s: %llu changes, %llu unchanged sections\n", name,
+			(unsigned long long)diff.changes(), (unsigned long long)diff.unchanged());
+
+	if(in.skipped() || in.invalid())
+		fprintf(stderr, "%s: %llu invalid sections, %llu bytes skipped\n", name,
+			(unsigned long long)in.invalid(), (unsigned long long)in.skipped());
+	return 0;
+}
+
+#endif
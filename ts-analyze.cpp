@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "ts.h"
+#include "json.h"
+#include "record.h"
+#include "tsanalyze.h"
+#include "workers.h"
+
+void usage() {
+	fprintf(stderr, "usage: ts-analyze [-b] [-j threads] [-c megabytes] file\n"
+		"\treports per PID packets, bitrate, transport errors, scrambling, continuity_counter\n"
+		"\terrors and PCR intervals of a transport stream capture, as one record\n"
+		"\t-b\tbinary record instead of JSON, see record.h\n"
+		"\t-j\tanalyze on this many threads, default one per CPU\n"
+		"\t-c\tsize of the pieces the file is analyzed in, default 32; the report depends on\n"
+		"\t\tit only where the stream is broken right at a boundary, never on -j\n"
+		"\tbitrates are by the PID whose PCRs span the most time, pcr_pid; without PCRs they are\n"
+		"\t0 and pcr_pid is 8191\n");
+	exit(1);
+}
+
+// A piece of the file, starting at a packet boundary
+struct Chunk {
+	const uint8_t* data_;
+	size_t size_;
+	TsAnalysis analysis_;
+};
+
+void analyze_chunk(Chunk& c, void*) {
+	c.analysis_.clear();
+	c.analysis_.scan(c.data_, c.size_);
+}
+
+void merge_finished(OrderedWorkers<Chunk>& pool, TsAnalysis& total, bool wait) {
+	while(Chunk* c = pool.finished(wait)) {
+		total.merge(c->analysis_);
+		pool.release();
+		wait = false;
+	}
+}
+
+uint32_t bitrate(uint64_t packets, uint64_t duration) {
+	return duration ? uint32_t(double(packets) * TS_PACKET_SIZE * 8 * TS_PCR_HZ / duration) : 0;
+}
+
+uint32_t pcr_us(uint64_t t) {
+	return t * 1000000 / TS_PCR_HZ;
+}
+
+template<class Out>
+void write_analysis(Out& os, TsAnalysis const& a) {
+	PidAnalysis const* clock = a.clock();
+	uint64_t duration = clock ? clock->interval_sum_ : 0;
+
+	os.begin(RECORD_TS_ANALYSIS);
+	os.number("packets", a.packets());
+	os.number("resyncs", a.resyncs());
+	os.number("skipped_bytes", a.skipped());
+	os.number("pcr_pid", clock ? clock->pid_ : TS_PID_NULL);
+	os.number("duration_ms", duration * 1000 / TS_PCR_HZ);
+	os.number("bitrate", bitrate(a.packets(), duration));
+
+	std::vector<PidAnalysis> pids(a.pids());
+	std::sort(pids.begin(), pids.end());
+	os.array("pids");
+	for(size_t i = 0; i < pids.size(); ++i) {
+		PidAnalysis const& p = pids[i];
+		os.object();
+		os.number("pid", p.pid_);
+		os.number("packets", p.packets_);
+		os.number("bitrate", bitrate(p.packets_, duration));
+		os.number("transport_errors", p.tei_);
+		os.number("scrambled_even", p.scrambled_even_);
+		os.number("scrambled_odd", p.scrambled_odd_);
+		os.number("cc_errors", p.cc_errors_);
+		os.number("duplicates", p.duplicates_);
+		os.number("discontinuities", p.discontinuities_);
+		os.number("pcrs", p.pcrs_);
+		os.number("pcr_interval_min_us", pcr_us(p.interval_min_));
+		os.number("pcr_interval_max_us", pcr_us(p.interval_max_));
+		os.number("pcr_interval_avg_us", p.intervals_ ? pcr_us(p.interval_sum_ / p.intervals_) : 0);
+		os.number("pcr_late", p.late_);
+		os.number("pcr_jumps", p.jumps_);
+		os.end_object();
+	}
+	os.end_array();
+	os.end();
+}
+
+int main(int argc, char* argv[]) {
+	bool binary = false;
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int megabytes = 32;
+
+	int opt;
+	while((opt = getopt(argc, argv, "bj:c:")) != -1) {
+		switch(opt) {
+		case 'b': binary = true; break;
+		case 'j': threads = atoi(optarg); break;
+		case 'c': megabytes = atoi(optarg); break;
+		default: usage();
+		}
+	}
+	if(argc - optind != 1 || threads <= 0 || megabytes <= 0)
+		usage();
+	size_t chunk_size = size_t(megabytes) << 20;
+
+	int fd = open(argv[optind], O_RDONLY);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st) < 0) {
+		perror(argv[optind]);
+		return 1;
+	}
+	size_t size = st.st_size;
+	const uint8_t* data = 0;
+	if(size) {
+		void* p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(p == MAP_FAILED) {
+			perror("mmap");
+			return 1;
+		}
+		data = static_cast<const uint8_t*>(p);
+		madvise(p, size, MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	TsAnalysis total;
+	{
+		OrderedWorkers<Chunk> pool(threads, threads * 2, analyze_chunk, 0);
+		// each chunk ends where the next one starts, its boundary found here in
+		// the same place whatever the number of threads
+		for(size_t start = 0; start < size;) {
+			size_t end = start + chunk_size < size ? ts_align(data, size, start + chunk_size) : size;
+			merge_finished(pool, total, pool.full());
+			Chunk& c = pool.next();
+			c.data_ = data + start;
+			c.size_ = end - start;
+			pool.submit();
+			start = end;
+		}
+		while(!pool.empty())
+			merge_finished(pool, total, true);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	fprintf(stderr, "ts-analyze: %llu packets, %u PIDs, %llu resyncs, %llu bytes skipped, %.0f MB/s\n",
+		(unsigned long long)total.packets(), unsigned(total.pids().size()), (unsigned long long)total.resyncs(),
+		(unsigned long long)total.skipped(), seconds > 0 ? size / seconds / 1e6 : 0.0);
+
+	JsonWriter out;
+	if(binary) {
+		BinaryRecord os(out);
+		write_analysis(os, total);
+	}
+	else {
+		JsonRecord os(out);
+		write_analysis(os, total);
+		out << '\n';
+	}
+	out.flush();
+
+	if(data)
+		munmap(const_cast<uint8_t*>(data), size);
+	return out.good() ? 0 : 1;
+}
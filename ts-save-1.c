@@ -3,8 +3,10 @@
 
 #include "mdemux.h"
 #include "common.h"
+#include "udpout.h"
 
 void send_buffer (struct mdemux_buffer* buffer, void *userdata);
+void send_udp (struct mdemux_buffer* buffer, void *userdata);
 
 struct mdemux_callback g_cb1 = {
 	.logger = console_logger,
@@ -14,6 +16,8 @@ struct mdemux_callback g_cb1 = {
 	.time = system_time
 };
 
+struct udpout g_udp;
+
 void send_buffer(struct mdemux_buffer* buffer, void *userdata)
 {
 	int ret;
@@ -38,6 +42,16 @@ void send_buffer(struct mdemux_buffer* buffer, void *userdata)
 	free(buffer->buf);
 }
 
+void send_udp(struct mdemux_buffer* buffer, void *userdata)
+{
+	int ret = udpout_write((struct udpout*)userdata, buffer->buf, buffer->fsize);
+	if(ret < 0) {
+		fprintf(stderr,"Got error %d while sending datagrams\n", -ret);
+		exit(-1);
+	}
+	free(buffer->buf);
+}
+
 int open_file(int pid)
 {
 	char fname[51];
@@ -57,23 +71,45 @@ int main(int argc, char **argv)
 	struct mdemux filter[1];
 	struct mdemux_poller poller;
 	int pid0;
-	int fd0;
+	int fd0 = -1;
+	const char *dest = NULL;
+	int opt;
 
-	if(argc != 2) {
-		fprintf(stderr,"usage: %s PID\n", argv[0]);
+	udpout_init(&g_udp);
+
+	while((opt = getopt(argc, argv, "u:R")) != -1) {
+		switch(opt) {
+		case 'u': dest = optarg; break;
+		case 'R': g_udp.rtp = 1; break;
+		default: argc = 0;
+		}
+	}
+
+	if(argc - optind != 1) {
+		fprintf(stderr,"usage: %s [-u host:port [-R]] PID\n", argv[0]);
 		exit(-1);
 	}
 
 	dbglevel_set(1);
 
-	pid0 = atoi(argv[1]);
+	pid0 = atoi(argv[optind]);
 
 	fprintf(stderr, "pid %d\n", pid0);
 
-	//fd0 = 1; //stdout 
-	fd0 = open_file(pid0);
-
-	mdemux_init(&filter[0], (void*)fd0);
+	if(dest) {
+		ret = udpout_open(&g_udp, dest);
+		if(ret < 0) {
+			fprintf(stderr,"Unable to open %s (errno %d)\n", dest, -ret);
+			exit(-1);
+		}
+		g_cb1.send_buffer = send_udp;
+		mdemux_init(&filter[0], &g_udp);
+	}
+	else {
+		//fd0 = 1; //stdout 
+		fd0 = open_file(pid0);
+		mdemux_init(&filter[0], (void*)fd0);
+	}
 	filter[0].s.pes_type = 0;
 	filter[0].s.adapter_id = 0;
 	filter[0].s.demux_id = 1;
@@ -105,7 +141,15 @@ int main(int argc, char **argv)
 	}
 
 	mdemux_close(&filter[0]);
-	close(fd0);
+	if(dest) {
+		udpout_close(&g_udp);
+		fprintf(stderr, "udp: %llu packets, %llu bytes, %llu datagrams in %llu calls, %llu dropped\n",
+			(unsigned long long)g_udp.stats.packets, (unsigned long long)g_udp.stats.bytes,
+			(unsigned long long)g_udp.stats.datagrams, (unsigned long long)g_udp.stats.syscalls,
+			(unsigned long long)g_udp.stats.dropped);
+	}
+	else
+		close(fd0);
 	return 0;
 }
 
@@ -0,0 +1,90 @@
+#ifndef _TS_H_
+#define _TS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TS_PACKET_SIZE 188
+#define TS_SYNC_BYTE 0x47
+#define TS_PID_NULL 0x1FFF
+#define TS_PID_ALL 0x2000
+
+/* PCR runs at 27 MHz and wraps at 2^33 * 300 */
+#define TS_PCR_HZ 27000000ull
+#define TS_PCR_WRAP (300ull << 33)
+
+static inline int ts_pid(const uint8_t *p)
+{
+  return ((p[1] & 0x1F) << 8) | p[2];
+}
+
+static inline int ts_tei(const uint8_t *p) { return (p[1] & 0x80) != 0; }
+static inline int ts_pusi(const uint8_t *p) { return (p[1] & 0x40) != 0; }
+static inline int ts_scrambling(const uint8_t *p) { return p[3] >> 6; }
+static inline int ts_has_adaptation(const uint8_t *p) { return (p[3] & 0x20) != 0; }
+static inline int ts_has_payload(const uint8_t *p) { return (p[3] & 0x10) != 0; }
+static inline int ts_cc(const uint8_t *p) { return p[3] & 0x0F; }
+
+/* Adaptation field length or -1 when the packet has no adaptation field */
+static inline int ts_adaptation_length(const uint8_t *p)
+{
+  return ts_has_adaptation(p) ? p[4] : -1;
+}
+
+static inline int ts_discontinuity(const uint8_t *p)
+{
+  return ts_adaptation_length(p) > 0 && (p[5] & 0x80);
+}
+
+/* Returns pointer to the payload and stores its size, NULL if there is none */
+static inline const uint8_t *ts_payload(const uint8_t *p, size_t *size)
+{
+  size_t off = 4;
+  if(!ts_has_payload(p))
+    return NULL;
+  if(ts_has_adaptation(p))
+    off += 1 + p[4];
+  if(off >= TS_PACKET_SIZE)
+    return NULL;
+  *size = TS_PACKET_SIZE - off;
+  return p + off;
+}
+
+/* Extracts PCR in 27 MHz units. Returns 1 if the packet carries one. */
+static inline int ts_pcr(const uint8_t *p, uint64_t *pcr)
+{
+  uint64_t base;
+  if(ts_adaptation_length(p) < 7 || !(p[5] & 0x10))
+    return 0;
+  base = ((uint64_t)p[6] << 25) | ((uint64_t)p[7] << 17) | ((uint64_t)p[8] << 9)
+    | ((uint64_t)p[9] << 1) | (p[10] >> 7);
+  *pcr = base * 300 + (((p[10] & 1) << 8) | p[11]);
+  return 1;
+}
+
+/* PCR difference b - a modulo wraparound */
+static inline int64_t ts_pcr_diff(uint64_t a, uint64_t b)
+{
+  int64_t d = (int64_t)((b + TS_PCR_WRAP - a) % TS_PCR_WRAP);
+  if(d > (int64_t)(TS_PCR_WRAP / 2))
+    d -= TS_PCR_WRAP;
+  return d;
+}
+
+/* Returns offset of the first packet boundary confirmed by up to 'confirm'
+ * following sync bytes, or -1 if there is none in the buffer. */
+static inline long ts_sync(const uint8_t *b, size_t n, int confirm)
+{
+  size_t i;
+  int k;
+  for(i = 0; i < TS_PACKET_SIZE && i < n; ++i) {
+    for(k = 0; k <= confirm && i + k * TS_PACKET_SIZE < n; ++k)
+      if(b[i + k * TS_PACKET_SIZE] != TS_SYNC_BYTE)
+        break;
+    if(k > confirm || i + k * TS_PACKET_SIZE >= n)
+      return i;
+  }
+  return -1;
+}
+
+#endif
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include <vector>
+
+#include "ts.h"
+#include "tsscan.h"
+#include "psi.h"
+#include "secframe.h"
+
+void usage() {
+	fprintf(stderr, "usage: ts2sec [-F] [-n] pid[,pid...]|all [file]\n"
+		"\treassembles sections from a transport stream and writes them to stdout\n"
+		"\t-F\tframe sections like sec-collect does\n"
+		"\t-n\tdo not drop sections with a bad CRC_32\n");
+	exit(1);
+}
+
+struct Writer {
+	Writer(bool framed) : framed_(framed) {
+		out_.reserve(1024*1024);
+	}
+
+	void operator () (int pid, const uint8_t* s, size_t n) {
+		if(framed_) {
+			timeval tv;
+			gettimeofday(&tv, 0);
+			secframe f = {uint16_t(pid), s[0], uint16_t(n), uint64_t(tv.tv_sec) * 1000000 + tv.tv_usec};
+			uint8_t h[SECFRAME_HEADER_SIZE];
+			secframe_write(h, &f);
+			out_.insert(out_.end(), h, h + sizeof(h));
+		}
+		out_.insert(out_.end(), s, s + n);
+		if(out_.size() >= 1024*1024)
+			flush();
+	}
+
+	void flush() {
+		for(size_t w = 0; w < out_.size();) {
+			ssize_t r = write(STDOUT_FILENO, &out_[w], out_.size() - w);
+			if(r < 0) {
+				if(errno == EINTR) continue;
+				perror("write");
+				exit(1);
+			}
+			w += r;
+		}
+		out_.clear();
+	}
+
+	bool framed_;
+	std::vector<uint8_t> out_;
+};
+
+struct Pusher {
+	SectionDemux& demux_;
+	Writer& w_;
+
+	bool operator () (const uint8_t* p) {
+		demux_.push(p, w_);
+		return true;
+	}
+};
+
+int main(int argc, char* argv[]) {
+	bool framed = false;
+	bool check_crc = true;
+
+	int opt;
+	while((opt = getopt(argc, argv, "Fn")) != -1) {
+		switch(opt) {
+		case 'F': framed = true; break;
+		case 'n': check_crc = false; break;
+		default: usage();
+		}
+	}
+
+	if(argc - optind < 1 || argc - optind > 2)
+		usage();
+
+	SectionDemux demux(check_crc);
+
+	if(strcmp(argv[optind], "all") == 0)
+		demux.add_pid(TS_PID_ALL);
+	else {
+		for(const char* s = argv[optind];;) {
+			char* e;
+			unsigned long pid = strtoul(s, &e, 0);
+			if(e == s || pid >= TS_PID_NULL) usage();
+			demux.add_pid(pid);
+			if(*e == 0) break;
+			if(*e != ',') usage();
+			s = e + 1;
+		}
+	}
+
+	int fd = STDIN_FILENO;
+	if(argc - optind == 2) {
+		fd = open(argv[optind + 1], O_RDONLY);
+		if(fd < 0) {
+			perror("open");
+			return 1;
+		}
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+
+	Writer w(framed);
+	std::vector<uint8_t> buf(TS_PACKET_SIZE * 4096);
+	size_t fill = 0;
+	PacketScanner scanner;
+	Pusher push = {demux, w};
+
+	for(;;) {
+		ssize_t r = read(fd, &buf[fill], buf.size() - fill);
+		if(r < 0) {
+			if(errno == EINTR) continue;
+			perror("read");
+			return 1;
+		}
+		if(r == 0)
+			break;
+		fill += r;
+
+		size_t off = scanner.scan(&buf[0], fill, push);
+		memmove(&buf[0], &buf[off], fill - off);
+		fill -= off;
+	}
+
+	w.flush();
+
+	SectionAssemblerStats st = demux.stats();
+	fprintf(stderr, "ts2sec: %llu sections, %llu bytes, %llu crc errors, %llu cc errors, %llu duplicates, %llu dropped, %llu resyncs\n",
+		(unsigned long long)st.sections_, (unsigned long long)st.bytes_, (unsigned long long)st.crc_errors_,
+		(unsigned long long)st.cc_errors_, (unsigned long long)st.duplicates_, (unsigned long long)st.dropped_,
+		(unsigned long long)scanner.resyncs());
+
+	return 0;
+}
@@ -0,0 +1,226 @@
+#ifndef _TSANALYZE_H_
+#define _TSANALYZE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "ts.h"
+#include "tsscan.h"
+
+// Transport stream statistics per PID, for a capture analyzed in chunks
+// on several threads: each chunk gets a TsAnalysis of its own, and the
+// analyses are merged in stream order. What depends on the packet before
+// (continuity_counter, PCR intervals) is kept for the first packet of a
+// chunk and checked against the chunk before it by merge().
+
+// PCR intervals over this are late (DVB wants a PCR every 40 ms), over this
+// or negative they are jumps unless the discontinuity_indicator is set
+#define TS_PCR_LATE (TS_PCR_HZ * 40 / 1000)
+#define TS_PCR_JUMP (TS_PCR_HZ / 10)
+
+struct PidAnalysis {
+	uint16_t pid_;
+	uint64_t packets_;
+	// packets with transport_error_indicator set, they are not looked at further
+	uint64_t tei_;
+	uint64_t scrambled_even_;
+	uint64_t scrambled_odd_;
+	uint64_t cc_errors_;
+	uint64_t duplicates_;
+	uint64_t discontinuities_;
+	// continuity_counter of the first and last packet with payload, -1 before one
+	int first_cc_;
+	int last_cc_;
+	bool first_discontinuity_;
+
+	uint64_t pcrs_;
+	uint64_t first_pcr_;
+	uint64_t last_pcr_;
+	bool first_pcr_discontinuity_;
+	// intervals between PCRs in 27 MHz units, jumps left out
+	uint64_t intervals_;
+	uint64_t interval_sum_;
+	uint64_t interval_min_;
+	uint64_t interval_max_;
+	uint64_t late_;
+	uint64_t jumps_;
+
+	explicit PidAnalysis(uint16_t pid = 0) : pid_(pid), packets_(0), tei_(0), scrambled_even_(0), scrambled_odd_(0),
+		cc_errors_(0), duplicates_(0), discontinuities_(0), first_cc_(-1), last_cc_(-1), first_discontinuity_(false),
+		pcrs_(0), first_pcr_(0), last_pcr_(0), first_pcr_discontinuity_(false),
+		intervals_(0), interval_sum_(0), interval_min_(0), interval_max_(0), late_(0), jumps_(0) {}
+
+	// A packet with payload; counts as SectionAssembler does
+	void next_cc(int cc, bool discontinuity) {
+		if(last_cc_ < 0) {
+			first_cc_ = cc;
+			first_discontinuity_ = discontinuity;
+		}
+		else if(!discontinuity && cc != ((last_cc_ + 1) & 0xF)) {
+			if(cc == last_cc_)
+				++duplicates_;
+			else
+				++cc_errors_;
+		}
+		last_cc_ = cc;
+	}
+
+	void next_pcr(uint64_t pcr, bool discontinuity) {
+		if(!pcrs_) {
+			first_pcr_ = pcr;
+			first_pcr_discontinuity_ = discontinuity;
+		}
+		else if(!discontinuity)
+			interval(ts_pcr_diff(last_pcr_, pcr));
+		last_pcr_ = pcr;
+		++pcrs_;
+	}
+
+	void interval(int64_t d) {
+		if(d < 0 || uint64_t(d) > TS_PCR_JUMP) {
+			++jumps_;
+			return;
+		}
+		interval_min_ = intervals_ ? std::min<uint64_t>(interval_min_, d) : d;
+		interval_max_ = std::max<uint64_t>(interval_max_, d);
+		interval_sum_ += d;
+		++intervals_;
+		late_ += uint64_t(d) > TS_PCR_LATE;
+	}
+
+	// Appends the analysis of the packets that follow in the stream
+	void merge(PidAnalysis const& a) {
+		packets_ += a.packets_;
+		tei_ += a.tei_;
+		scrambled_even_ += a.scrambled_even_;
+		scrambled_odd_ += a.scrambled_odd_;
+		cc_errors_ += a.cc_errors_;
+		duplicates_ += a.duplicates_;
+		discontinuities_ += a.discontinuities_;
+		if(a.first_cc_ >= 0) {
+			next_cc(a.first_cc_, a.first_discontinuity_);
+			last_cc_ = a.last_cc_;
+		}
+
+		if(a.pcrs_) {
+			uint64_t pcrs = pcrs_;
+			next_pcr(a.first_pcr_, a.first_pcr_discontinuity_);
+			last_pcr_ = a.last_pcr_;
+			pcrs_ = pcrs + a.pcrs_;
+		}
+		if(a.intervals_) {
+			interval_min_ = intervals_ ? std::min(interval_min_, a.interval_min_) : a.interval_min_;
+			interval_max_ = std::max(interval_max_, a.interval_max_);
+		}
+		intervals_ += a.intervals_;
+		interval_sum_ += a.interval_sum_;
+		late_ += a.late_;
+		jumps_ += a.jumps_;
+	}
+
+	bool operator < (PidAnalysis const& a) const { return pid_ < a.pid_; }
+};
+
+class TsAnalysis {
+public:
+	TsAnalysis() : index_(TS_PID_NULL + 1, -1), packets_(0), resyncs_(0), skipped_(0) {}
+
+	void clear() {
+		for(size_t i = 0; i < pids_.size(); ++i)
+			index_[pids_[i].pid_] = -1;
+		pids_.clear();
+		packets_ = resyncs_ = skipped_ = 0;
+	}
+
+	// A piece of the stream, starting at a packet boundary as far as the
+	// caller knows; a partial packet at its end counts as skipped
+	void scan(const uint8_t* b, size_t n) {
+		PacketScanner scanner;
+		size_t used = scanner.scan(b, n, *this);
+		scanner.finish(n - used);
+		resyncs_ += scanner.resyncs();
+		skipped_ += scanner.skipped();
+	}
+
+	bool operator () (const uint8_t* p) {
+		PidAnalysis& a = pid(ts_pid(p));
+		++packets_;
+		++a.packets_;
+		if(ts_tei(p)) {
+			++a.tei_;
+			return true;
+		}
+
+		switch(ts_scrambling(p)) {
+		case 2: ++a.scrambled_even_; break;
+		case 3: ++a.scrambled_odd_; break;
+		}
+		bool discontinuity = ts_discontinuity(p);
+		a.discontinuities_ += discontinuity;
+		if(ts_has_payload(p) && a.pid_ != TS_PID_NULL)
+			a.next_cc(ts_cc(p), discontinuity);
+
+		uint64_t pcr;
+		if(ts_pcr(p, &pcr))
+			a.next_pcr(pcr, discontinuity);
+		return true;
+	}
+
+	// Appends the analysis of the piece of the stream after this one
+	void merge(TsAnalysis const& a) {
+		for(size_t i = 0; i < a.pids_.size(); ++i)
+			pid(a.pids_[i].pid_).merge(a.pids_[i]);
+		packets_ += a.packets_;
+		resyncs_ += a.resyncs_;
+		skipped_ += a.skipped_;
+	}
+
+	// In order of first appearance
+	std::vector<PidAnalysis> const& pids() const { return pids_; }
+
+	// The PID with the most time between its PCRs, the stream clock; 0 if none
+	PidAnalysis const* clock() const {
+		PidAnalysis const* c = 0;
+		for(size_t i = 0; i < pids_.size(); ++i)
+			if(pids_[i].interval_sum_ && (!c || pids_[i].interval_sum_ > c->interval_sum_))
+				c = &pids_[i];
+		return c;
+	}
+
+	uint64_t packets() const { return packets_; }
+	uint64_t resyncs() const { return resyncs_; }
+	uint64_t skipped() const { return skipped_; }
+
+private:
+	PidAnalysis& pid(uint16_t pid) {
+		int& i = index_[pid];
+		if(i < 0) {
+			i = pids_.size();
+			pids_.push_back(PidAnalysis(pid));
+		}
+		return pids_[i];
+	}
+
+	// into pids_, -1 for a PID not seen
+	std::vector<int> index_;
+	std::vector<PidAnalysis> pids_;
+	uint64_t packets_;
+	uint64_t resyncs_;
+	uint64_t skipped_;
+};
+
+// The first packet boundary at or after 'off' confirmed by the sync bytes
+// of the next three packets, n if there is none
+inline size_t ts_align(const uint8_t* b, size_t n, size_t off) {
+	for(; off < n; off += TS_PACKET_SIZE) {
+		long s = ts_sync(b + off, n - off, 3);
+		if(s >= 0)
+			return std::min(off + s, n);
+	}
+	return n;
+}
+
+#endif
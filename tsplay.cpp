@@ -0,0 +1,241 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <stdexcept>
+#include <system_error>
+#include <string>
+#include <algorithm>
+
+#include "ts.h"
+#include "udpout.h"
+
+static volatile sig_atomic_t g_stop = 0;
+static volatile sig_atomic_t g_report = 0;
+
+static void sighandler(int n) {
+  if(n == SIGUSR1)
+    g_report = 1;
+  else
+    g_stop = 1;
+}
+
+static const int64_t NSEC = 1000000000ll;
+
+static int64_t now() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * NSEC + ts.tv_nsec;
+}
+
+static void sleep_until(int64_t t) {
+  timespec ts;
+  ts.tv_sec = t / NSEC;
+  ts.tv_nsec = t % NSEC;
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR && !g_stop)
+    ;
+}
+
+// Lateness of every output burst relative to its PCR derived deadline.
+struct Jitter {
+  uint64_t count_;
+  double sum_;
+  double sumsq_;
+  int64_t max_;
+
+  void add(int64_t late) {
+    ++count_;
+    sum_ += late;
+    sumsq_ += double(late) * late;
+    if(late > max_) max_ = late;
+  }
+};
+
+struct PlayStats {
+  uint64_t packets_;
+  uint64_t rebases_;
+  int64_t start_;
+  Jitter jitter_;
+};
+
+static void report(PlayStats const& s) {
+  double t = double(now() - s.start_) / NSEC;
+  double mean = s.jitter_.count_ ? s.jitter_.sum_ / s.jitter_.count_ : 0;
+  double var = s.jitter_.count_ ? s.jitter_.sumsq_ / s.jitter_.count_ - mean * mean : 0;
+  fprintf(stderr, "tsplay: %llu packets, %.3f s, %.3f Mbit/s, %llu pcr rebases, "
+    "jitter mean %.1f us, stddev %.1f us, max %.1f us\n",
+    (unsigned long long)s.packets_, t, t > 0 ? s.packets_ * TS_PACKET_SIZE * 8 / t / 1e6 : 0.0,
+    (unsigned long long)s.rebases_, mean / 1e3, var > 0 ? sqrt(var) / 1e3 : 0.0, s.jitter_.max_ / 1e3);
+}
+
+static void usage() {
+  fprintf(stderr, "usage: tsplay [-l] [-p pcr_pid] [-n packets_per_burst] [-u host:port [-R]] file\n");
+  exit(1);
+}
+
+static void write_all(udpout& u, const uint8_t* b, size_t n) {
+  if(u.fd >= 0) {
+    int ret = udpout_write(&u, b, n);
+    if(ret == 0) ret = udpout_flush(&u);
+    if(ret < 0) throw std::system_error(-ret, std::system_category());
+    return;
+  }
+
+  int fd = STDOUT_FILENO;
+  for(size_t w = 0; w < n;) {
+    ssize_t r = write(fd, b + w, n - w);
+    if(r < 0) {
+      if(errno == EINTR) continue;
+      throw std::system_error(errno, std::system_category());
+    }
+    w += r;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  bool loop = false;
+  int pcr_pid = -1;
+  size_t burst = 7;
+  const char* dest = 0;
+
+  static udpout udp;
+  udpout_init(&udp);
+
+  int opt;
+  while((opt = getopt(argc, argv, "lp:n:u:R")) != -1) {
+    switch(opt) {
+    case 'l': loop = true; break;
+    case 'p': pcr_pid = strtol(optarg, 0, 0); break;
+    case 'n': burst = strtoul(optarg, 0, 0); if(burst == 0) usage(); break;
+    case 'u': dest = optarg; break;
+    case 'R': udp.rtp = 1; break;
+    default: usage();
+    }
+  }
+
+  if(argc - optind != 1) usage();
+
+  if(dest) {
+    int ret = udpout_open(&udp, dest);
+    if(ret < 0) throw std::system_error(-ret, std::system_category());
+  }
+
+  int fd = open(argv[optind], O_RDONLY);
+  if(fd == -1) throw std::system_error(errno, std::system_category());
+
+  struct stat st;
+  if(fstat(fd, &st) < 0) throw std::system_error(errno, std::system_category());
+
+  const uint8_t* data = static_cast<const uint8_t*>(mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+  if(data == MAP_FAILED) throw std::system_error(errno, std::system_category());
+  madvise(const_cast<uint8_t*>(data), st.st_size, MADV_SEQUENTIAL);
+
+  long off = ts_sync(data, st.st_size, 4);
+  if(off < 0) throw std::runtime_error("no transport stream sync found");
+
+  const uint8_t* begin = data + off;
+  size_t count = (st.st_size - off) / TS_PACKET_SIZE;
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = sighandler;
+  sigaction(SIGINT, &sa, 0);
+  sigaction(SIGTERM, &sa, 0);
+  sigaction(SIGUSR1, &sa, 0);
+
+  PlayStats stats = {0};
+  stats.start_ = now();
+
+  // Packets between two PCRs are spread evenly over the PCR interval,
+  // bursts before the first PCR (and after a rebase) go out immediately.
+  do {
+    bool have_base = false;
+    uint64_t base_pcr = 0;
+    int64_t base_time = 0;
+    size_t seg_begin = 0;
+    uint64_t seg_pcr = 0;
+
+    for(size_t i = 0; i < count && !g_stop; ++i) {
+      const uint8_t* p = begin + i * TS_PACKET_SIZE;
+      uint64_t pcr;
+      bool last = i + 1 == count;
+
+      if(!last && (p[0] != TS_SYNC_BYTE || (pcr_pid >= 0 && ts_pid(p) != pcr_pid) || !ts_pcr(p, &pcr)))
+        continue;
+
+      if(last) {
+        // tail after the last PCR is sent at once
+        for(size_t j = seg_begin; j < count; j += burst) {
+          size_t n = std::min(burst, count - j);
+          write_all(udp, begin + j * TS_PACKET_SIZE, n * TS_PACKET_SIZE);
+          stats.packets_ += n;
+        }
+        break;
+      }
+
+      if(pcr_pid < 0) pcr_pid = ts_pid(p);
+
+      int64_t seg_ns = 0;
+      if(have_base) {
+        int64_t d = ts_pcr_diff(seg_pcr, pcr);
+        // a PCR jump of more than a second is a discontinuity or a loop point
+        if(d <= 0 || uint64_t(d) > TS_PCR_HZ || ts_discontinuity(p)) {
+          have_base = false;
+          ++stats.rebases_;
+        }
+        else
+          seg_ns = d * 1000 / 27;
+      }
+
+      int64_t seg_start = have_base ? base_time + ts_pcr_diff(base_pcr, seg_pcr) * 1000 / 27 : now();
+      size_t seg_packets = i - seg_begin;
+
+      for(size_t j = seg_begin; j < i && !g_stop; j += burst) {
+        if(have_base) {
+          int64_t target = seg_start + seg_ns * int64_t(j - seg_begin) / int64_t(seg_packets);
+          sleep_until(target);
+          stats.jitter_.add(now() - target);
+        }
+
+        size_t n = std::min(burst, i - j);
+        write_all(udp, begin + j * TS_PACKET_SIZE, n * TS_PACKET_SIZE);
+        stats.packets_ += n;
+
+        if(g_report) {
+          g_report = 0;
+          report(stats);
+        }
+      }
+
+      if(!have_base) {
+        have_base = true;
+        base_pcr = pcr;
+        base_time = now();
+      }
+      seg_begin = i;
+      seg_pcr = pcr;
+    }
+  } while(loop && !g_stop);
+
+  report(stats);
+  if(dest) {
+    udpout_close(&udp);
+    fprintf(stderr, "tsplay: udp %llu datagrams in %llu calls, %llu dropped\n",
+      (unsigned long long)udp.stats.datagrams, (unsigned long long)udp.stats.syscalls, (unsigned long long)udp.stats.dropped);
+  }
+
+  return 0;
+}
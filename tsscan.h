@@ -0,0 +1,61 @@
+#ifndef _TSSCAN_H_
+#define _TSSCAN_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <algorithm>
+
+#include "ts.h"
+
+// Finds the packets of a transport stream in a buffer that may have lost
+// or gained bytes. A packet is taken where a sync byte is; after a loss of
+// sync a new boundary has to be confirmed by the sync bytes of the packets
+// after it, and the bytes passed over until then are counted.
+class PacketScanner {
+public:
+	PacketScanner() : synced_(false), resyncs_(0), skipped_(0) {}
+
+	// Calls f(packet) for the packets in b[0, n) as long as it returns
+	// true. Returns how many bytes were used; the rest, less than a packet
+	// unless f stopped the scan, belongs in front of the next call's bytes.
+	template<class F>
+	size_t scan(const uint8_t* b, size_t n, F& f) {
+		size_t off = 0;
+		while(n - off >= TS_PACKET_SIZE) {
+			const uint8_t* p = b + off;
+			// after a loss of sync the next packet has to confirm the boundary
+			if(p[0] != TS_SYNC_BYTE || (!synced_ && n - off >= 2 * TS_PACKET_SIZE && p[TS_PACKET_SIZE] != TS_SYNC_BYTE)) {
+				long s = ts_sync(p + 1, n - off - 1, 3);
+				if(synced_)
+					++resyncs_;
+				synced_ = false;
+				// ts_sync() takes a boundary it cannot confirm for lack of bytes, so
+				// -1 means none of the next 188 bytes starts a packet: look further
+				size_t next = s < 0 ? std::min(off + 1 + TS_PACKET_SIZE, n) : off + 1 + s;
+				skipped_ += next - off;
+				off = next;
+				continue;
+			}
+			synced_ = true;
+			off += TS_PACKET_SIZE;
+			if(!f(p))
+				break;
+		}
+		return off;
+	}
+
+	// Bytes left over at the end of the input
+	void finish(size_t n) { skipped_ += n; }
+
+	// times sync was lost, and the bytes skipped to find it again
+	uint64_t resyncs() const { return resyncs_; }
+	uint64_t skipped() const { return skipped_; }
+
+private:
+	bool synced_;
+	uint64_t resyncs_;
+	uint64_t skipped_;
+};
+
+#endif
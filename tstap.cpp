@@ -1,43 +1,208 @@
 #include <unistd.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <time.h>
 #include <sys/ioctl.h>
 #include <linux/dvb/dmx.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
 
 #include <stdexcept>
 #include <system_error>
+#include <vector>
+
+#include "udpout.h"
+
+static const uint16_t PID_ALL = 0x2000;
+
+static volatile sig_atomic_t g_stop = 0;
+static volatile sig_atomic_t g_report = 0;
+
+static void sighandler(int n) {
+  if(n == SIGUSR1)
+    g_report = 1;
+  else
+    g_stop = 1;
+}
+
+struct TapStats {
+  uint64_t bytes_;
+  uint64_t reads_;
+  uint64_t overflows_;
+  timespec start_;
+};
+
+static double elapsed(timespec const& start) {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static void report(TapStats const& s) {
+  double t = elapsed(s.start_);
+  fprintf(stderr, "tstap: %llu bytes (%llu packets) in %llu reads, %llu overflows, %.3f s, %.3f Mbit/s\n",
+    (unsigned long long)s.bytes_, (unsigned long long)(s.bytes_ / 188), (unsigned long long)s.reads_,
+    (unsigned long long)s.overflows_, t, t > 0 ? s.bytes_ * 8 / t / 1e6 : 0.0);
+}
+
+static void report(udpout const& u) {
+  fprintf(stderr, "tstap: udp %llu packets, %llu bytes, %llu datagrams in %llu calls, %llu dropped\n",
+    (unsigned long long)u.stats.packets, (unsigned long long)u.stats.bytes, (unsigned long long)u.stats.datagrams,
+    (unsigned long long)u.stats.syscalls, (unsigned long long)u.stats.dropped);
+}
+
+static void usage() {
+  fprintf(stderr, "usage: tstap [-b demux_buffer_size] [-r read_size] [-d dvr_device] [-u host:port [-R] [-B bitrate]]\n"
+    "             demux_device pid[,pid...]|all\n");
+  exit(1);
+}
+
+static size_t parse_size(const char* s) {
+  char* e;
+  unsigned long v = strtoul(s, &e, 0);
+  if(e == s) usage();
+  if(*e == 'k' || *e == 'K') v *= 1024;
+  else if(*e == 'm' || *e == 'M') v *= 1024*1024;
+  else if(*e) usage();
+  if(v == 0) usage();
+  return v;
+}
+
+static std::vector<uint16_t> parse_pids(const char* s) {
+  std::vector<uint16_t> pids;
+  if(strcmp(s, "all") == 0) {
+    pids.push_back(PID_ALL);
+    return pids;
+  }
+
+  for(;;) {
+    char* e;
+    unsigned long pid = strtoul(s, &e, 0);
+    if(e == s || pid > PID_ALL) throw std::runtime_error("invalid pid value");
+    pids.push_back(pid);
+    if(*e == 0) break;
+    if(*e != ',') throw std::runtime_error("invalid pid value");
+    s = e + 1;
+  }
+
+  return pids;
+}
 
 int main(int argc, char* argv[]) {
-  int fd = open(argv[1], O_RDWR);
-  if(fd == -1) throw std::system_error(errno, std::system_category());
+  size_t buffer_size = 1024*1024;
+  size_t read_size = 188*1024;
+  const char* dvr = 0;
+  const char* dest = 0;
 
-  size_t pid;
-  if(sscanf(argv[2], "%lu", &pid) != 1) throw std::runtime_error("invalid pid value");
+  static udpout udp;
+  udpout_init(&udp);
 
-  ioctl(fd, DMX_SET_BUFFER_SIZE, 128*1024);
+  int opt;
+  while((opt = getopt(argc, argv, "b:r:d:u:RB:")) != -1) {
+    switch(opt) {
+    case 'b': buffer_size = parse_size(optarg); break;
+    case 'r': read_size = parse_size(optarg); break;
+    case 'd': dvr = optarg; break;
+    case 'u': dest = optarg; break;
+    case 'R': udp.rtp = 1; break;
+    case 'B': udp.bitrate = parse_size(optarg); break;
+    default: usage();
+    }
+  }
+
+  if(argc - optind != 2) usage();
+
+  std::vector<uint16_t> pids = parse_pids(argv[optind + 1]);
+
+  if(dest) {
+    int ret = udpout_open(&udp, dest);
+    if(ret < 0) throw std::system_error(-ret, std::system_category());
+  }
+
+  int fd = open(argv[optind], O_RDWR);
+  if(fd == -1) throw std::system_error(errno, std::system_category());
+
+  int in = fd;
+  if(dvr) {
+    in = open(dvr, O_RDONLY);
+    if(in == -1) throw std::system_error(errno, std::system_category());
+    if(ioctl(in, DMX_SET_BUFFER_SIZE, buffer_size) < 0) throw std::system_error(errno, std::system_category());
+  }
+  else if(ioctl(fd, DMX_SET_BUFFER_SIZE, buffer_size) < 0) throw std::system_error(errno, std::system_category());
 
   dmx_pes_filter_params params = {0};
-  params.pid = pid;
+  params.pid = pids[0];
   params.input = DMX_IN_FRONTEND;
-  params.output = static_cast<dmx_output_t>(DMX_OUT_TAP | DMX_OUT_TS_TAP);
+  params.output = dvr ? DMX_OUT_TS_TAP : static_cast<dmx_output_t>(DMX_OUT_TAP | DMX_OUT_TS_TAP);
   params.pes_type = static_cast<dmx_pes_type_t>(0);
   params.flags = DMX_IMMEDIATE_START;
-  
+
   if(ioctl(fd, DMX_SET_PES_FILTER, &params) < 0) throw std::system_error(errno, std::system_category());
-  
-  for(;;) {
-    char buf[4096];
-    int r = read(fd, buf, sizeof(buf));
-    
-    if(r < 0)
+
+  for(size_t i = 1; i < pids.size(); ++i) {
+    if(ioctl(fd, DMX_ADD_PID, &pids[i]) < 0) throw std::system_error(errno, std::system_category());
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = sighandler;
+  sigaction(SIGINT, &sa, 0);
+  sigaction(SIGTERM, &sa, 0);
+  sigaction(SIGUSR1, &sa, 0);
+
+  TapStats stats = {0};
+  clock_gettime(CLOCK_MONOTONIC, &stats.start_);
+
+  std::vector<char> buf(read_size);
+
+  while(!g_stop) {
+    if(g_report) {
+      g_report = 0;
+      report(stats);
+      if(dest) report(udp);
+    }
+
+    ssize_t r = read(in, &buf[0], buf.size());
+
+    if(r < 0) {
+      if(errno == EINTR) continue;
+      if(errno == EOVERFLOW) {
+        ++stats.overflows_;
+        continue;
+      }
       throw std::system_error(errno, std::system_category());
+    }
     else if(r == 0)
       break;
 
-    if(write(STDOUT_FILENO, buf, r) < 0) throw std::system_error(errno, std::system_category()); 
+    ++stats.reads_;
+    stats.bytes_ += r;
+
+    if(dest) {
+      int ret = udpout_write(&udp, reinterpret_cast<const uint8_t*>(&buf[0]), r);
+      if(ret < 0) throw std::system_error(-ret, std::system_category());
+      continue;
+    }
+
+    for(ssize_t w = 0; w < r;) {
+      ssize_t n = write(STDOUT_FILENO, &buf[w], r - w);
+      if(n < 0) {
+        if(errno == EINTR) continue;
+        throw std::system_error(errno, std::system_category());
+      }
+      w += n;
+    }
+  }
+
+  report(stats);
+  if(dest) {
+    udpout_close(&udp);
+    report(udp);
   }
 
   return 0;
 }
-
@@ -0,0 +1,212 @@
+#define _GNU_SOURCE
+#include "udpout.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#define NSEC 1000000000ll
+
+static int64_t udpout_time(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * NSEC + ts.tv_nsec;
+}
+
+void udpout_init(struct udpout *u)
+{
+  memset(&u->stats, 0, sizeof(u->stats));
+  u->rtp = 0;
+  u->bitrate = 0;
+  u->fd = -1;
+  u->seq = 0;
+  u->ssrc = (uint32_t)getpid() ^ (uint32_t)udpout_time();
+  u->next_time = -1;
+  u->count = 0;
+  u->fill = 0;
+}
+
+int udpout_open(struct udpout *u, const char *dest)
+{
+  char host[64];
+  const char *colon = strrchr(dest, ':');
+  struct sockaddr_in addr;
+
+  if(colon == NULL || (size_t)(colon - dest) >= sizeof(host))
+    return -EINVAL;
+
+  memcpy(host, dest, colon - dest);
+  host[colon - dest] = 0;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(atoi(colon + 1));
+  if(!inet_aton(host, &addr.sin_addr))
+    return -EINVAL;
+
+  u->fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if(u->fd < 0)
+    return -errno;
+
+  if(connect(u->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    int e = errno;
+    close(u->fd);
+    u->fd = -1;
+    return -e;
+  }
+
+  return 0;
+}
+
+static void udpout_rtp_header(struct udpout *u, uint8_t *h, int64_t now)
+{
+  uint32_t ts = (uint32_t)(now / (NSEC / 90000));
+  h[0] = 0x80;
+  h[1] = UDPOUT_RTP_MP2T;
+  h[2] = u->seq >> 8;
+  h[3] = u->seq & 0xFF;
+  h[4] = ts >> 24;
+  h[5] = ts >> 16;
+  h[6] = ts >> 8;
+  h[7] = ts;
+  h[8] = u->ssrc >> 24;
+  h[9] = u->ssrc >> 16;
+  h[10] = u->ssrc >> 8;
+  h[11] = u->ssrc;
+  ++u->seq;
+}
+
+/* Sleeps until the batch of 'bytes' is due according to the pacing rate */
+static void udpout_pace(struct udpout *u, size_t bytes)
+{
+  int64_t now = udpout_time();
+  struct timespec ts;
+
+  /* more than a second behind: restart the schedule */
+  if(u->next_time < 0 || now - u->next_time > NSEC)
+    u->next_time = now;
+
+  ts.tv_sec = u->next_time / NSEC;
+  ts.tv_nsec = u->next_time % NSEC;
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    ;
+
+  u->next_time += (int64_t)bytes * 8 * NSEC / (int64_t)u->bitrate;
+}
+
+static int udpout_send(struct udpout *u, unsigned n)
+{
+  struct mmsghdr msgs[UDPOUT_BATCH];
+  struct iovec iov[UDPOUT_BATCH];
+  unsigned i, sent = 0;
+  size_t bytes = 0;
+  int64_t now;
+
+  if(n == 0)
+    return 0;
+
+  for(i = 0; i < n; ++i)
+    bytes += u->len[i];
+
+  if(u->bitrate)
+    udpout_pace(u, bytes);
+
+  now = udpout_time();
+  memset(msgs, 0, sizeof(msgs[0]) * n);
+  for(i = 0; i < n; ++i) {
+    size_t off = UDPOUT_RTP_HEADER;
+    if(u->rtp) {
+      off = 0;
+      udpout_rtp_header(u, u->buf[i], now);
+    }
+    iov[i].iov_base = u->buf[i] + off;
+    iov[i].iov_len = u->len[i] + UDPOUT_RTP_HEADER - off;
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  while(sent < n) {
+    int r = sendmmsg(u->fd, msgs + sent, n - sent, 0);
+    ++u->stats.syscalls;
+    if(r < 0) {
+      if(errno == EINTR)
+        continue;
+      /* nobody listens on a loopback port yet, drop the datagram */
+      if(errno == ECONNREFUSED) {
+        ++u->stats.dropped;
+        ++sent;
+        continue;
+      }
+      u->stats.dropped += n - sent;
+      return -errno;
+    }
+    for(i = sent; i < sent + r; ++i) {
+      u->stats.datagrams++;
+      u->stats.bytes += u->len[i];
+      u->stats.packets += u->len[i] / 188;
+    }
+    sent += r;
+  }
+
+  return 0;
+}
+
+int udpout_write(struct udpout *u, const uint8_t *data, size_t size)
+{
+  const size_t payload = UDPOUT_TS_PER_DGRAM * 188;
+
+  while(size > 0) {
+    size_t n = payload - u->fill;
+    if(n > size)
+      n = size;
+
+    /* payload always starts after the room reserved for the RTP header */
+    memcpy(u->buf[u->count] + UDPOUT_RTP_HEADER + u->fill, data, n);
+    u->fill += n;
+    data += n;
+    size -= n;
+
+    if(u->fill == payload) {
+      u->len[u->count++] = u->fill;
+      u->fill = 0;
+      if(u->count == UDPOUT_BATCH) {
+        int ret = udpout_send(u, u->count);
+        u->count = 0;
+        if(ret < 0)
+          return ret;
+      }
+    }
+  }
+
+  return 0;
+}
+
+int udpout_flush(struct udpout *u)
+{
+  int ret;
+
+  if(u->fill) {
+    u->len[u->count++] = u->fill;
+    u->fill = 0;
+  }
+
+  ret = udpout_send(u, u->count);
+  u->count = 0;
+  return ret;
+}
+
+void udpout_close(struct udpout *u)
+{
+  if(u->fd < 0)
+    return;
+  udpout_flush(u);
+  close(u->fd);
+  u->fd = -1;
+}
@@ -0,0 +1,71 @@
+#ifndef _UDPOUT_H_
+#define _UDPOUT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* TS packets per datagram, 7*188 fits a 1500 byte MTU with RTP header */
+#define UDPOUT_TS_PER_DGRAM 7
+/* datagrams handed to one sendmmsg() call */
+#define UDPOUT_BATCH 32
+#define UDPOUT_RTP_HEADER 12
+#define UDPOUT_DGRAM_MAX (UDPOUT_RTP_HEADER + UDPOUT_TS_PER_DGRAM * 188)
+
+/* RTP payload type of MPEG-2 TS (RFC 3551) */
+#define UDPOUT_RTP_MP2T 33
+
+struct udpout_stats {
+  /* TS packets and payload bytes sent */
+  uint64_t packets;
+  uint64_t bytes;
+  uint64_t datagrams;
+  /* sendmmsg calls */
+  uint64_t syscalls;
+  /* datagrams dropped on send errors */
+  uint64_t dropped;
+};
+
+struct udpout {
+  /* write_once - set after init, before the first write */
+  int rtp;
+  /* write_once - pacing rate in bits/sec, 0 sends as fast as possible */
+  uint64_t bitrate;
+  /* readonly */
+  struct udpout_stats stats;
+  /* private */
+  int fd;
+  uint16_t seq;
+  uint32_t ssrc;
+  int64_t next_time;
+  unsigned count;
+  size_t fill;
+  size_t len[UDPOUT_BATCH];
+  uint8_t buf[UDPOUT_BATCH][UDPOUT_DGRAM_MAX];
+};
+
+/* Initializes the sender and sets its settings to their default values */
+void udpout_init(struct udpout *u);
+
+/* Opens a socket connected to "host:port". Returns 0 or -errno. */
+int udpout_open(struct udpout *u, const char *dest);
+
+/* Queues TS data, complete datagrams are sent in batches.
+ * Returns 0 or -errno. */
+int udpout_write(struct udpout *u, const uint8_t *data, size_t size);
+
+/* Sends all queued datagrams including a partially filled one */
+int udpout_flush(struct udpout *u);
+
+/* Flushes and closes the socket */
+void udpout_close(struct udpout *u);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,216 @@
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include <stdexcept>
+#include <system_error>
+#include <string>
+#include <vector>
+
+#include "ts.h"
+#include "udpout.h"
+
+static volatile sig_atomic_t g_stop = 0;
+static volatile sig_atomic_t g_report = 0;
+
+static void sighandler(int n) {
+  if(n == SIGUSR1)
+    g_report = 1;
+  else
+    g_stop = 1;
+}
+
+static double now() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct RecvStats {
+  uint64_t datagrams_;
+  uint64_t packets_;
+  uint64_t bytes_;
+  uint64_t syscalls_;
+  uint64_t rtp_lost_;
+  uint64_t cc_errors_;
+  uint64_t sync_errors_;
+  double first_;
+  double last_;
+};
+
+static void report(RecvStats const& s) {
+  double t = s.last_ - s.first_;
+  fprintf(stderr, "udprecv: %llu datagrams in %llu calls, %llu packets, %llu bytes, %.3f s, %.3f Mbit/s, "
+    "%llu rtp lost, %llu cc errors, %llu sync errors\n",
+    (unsigned long long)s.datagrams_, (unsigned long long)s.syscalls_, (unsigned long long)s.packets_,
+    (unsigned long long)s.bytes_, t, t > 0 ? s.bytes_ * 8 / t / 1e6 : 0.0,
+    (unsigned long long)s.rtp_lost_, (unsigned long long)s.cc_errors_, (unsigned long long)s.sync_errors_);
+}
+
+static void usage() {
+  fprintf(stderr, "usage: udprecv [-o] [-t report_interval] [host:]port\n");
+  exit(1);
+}
+
+// Per PID continuity counter check as a TS analyzer does it: a single
+// repeated counter is a legal duplicate, discontinuity_indicator resets.
+struct CcChecker {
+  CcChecker() : last_(TS_PID_ALL, -1) {}
+
+  bool check(const uint8_t* p) {
+    int pid = ts_pid(p);
+    if(pid == TS_PID_NULL) return true;
+
+    int& last = last_[pid];
+    int cc = ts_cc(p);
+    bool ok = true;
+
+    if(!ts_has_payload(p))
+      ok = last < 0 || cc == last;
+    else if(last >= 0 && !ts_discontinuity(p))
+      ok = cc == ((last + 1) & 0xF) || cc == last;
+
+    last = cc;
+    return ok;
+  }
+
+  std::vector<int> last_;
+};
+
+int main(int argc, char* argv[]) {
+  bool output = false;
+  double interval = 0;
+
+  int opt;
+  while((opt = getopt(argc, argv, "ot:")) != -1) {
+    switch(opt) {
+    case 'o': output = true; break;
+    case 't': interval = atof(optarg); break;
+    default: usage();
+    }
+  }
+
+  if(argc - optind != 1) usage();
+
+  std::string spec(argv[optind]);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  size_t colon = spec.rfind(':');
+  if(colon != std::string::npos) {
+    if(!inet_aton(spec.substr(0, colon).c_str(), &addr.sin_addr)) usage();
+    spec = spec.substr(colon + 1);
+  }
+  addr.sin_port = htons(atoi(spec.c_str()));
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if(fd < 0) throw std::system_error(errno, std::system_category());
+
+  int rcvbuf = 4*1024*1024;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  if(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) throw std::system_error(errno, std::system_category());
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = sighandler;
+  sigaction(SIGINT, &sa, 0);
+  sigaction(SIGTERM, &sa, 0);
+  sigaction(SIGUSR1, &sa, 0);
+
+  static const size_t batch = 64;
+  std::vector<uint8_t> bufs(batch * UDPOUT_DGRAM_MAX);
+  mmsghdr msgs[batch];
+  iovec iov[batch];
+
+  RecvStats stats = {0};
+  CcChecker cc;
+  int rtp_seq = -1;
+  double next_report = 0;
+
+  while(!g_stop) {
+    if(g_report) {
+      g_report = 0;
+      report(stats);
+    }
+
+    memset(msgs, 0, sizeof(msgs));
+    for(size_t i = 0; i < batch; ++i) {
+      iov[i].iov_base = &bufs[i * UDPOUT_DGRAM_MAX];
+      iov[i].iov_len = UDPOUT_DGRAM_MAX;
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int n = recvmmsg(fd, msgs, batch, MSG_WAITFORONE, 0);
+    if(n < 0) {
+      if(errno == EINTR) continue;
+      throw std::system_error(errno, std::system_category());
+    }
+
+    double t = now();
+    if(stats.datagrams_ == 0) {
+      stats.first_ = t;
+      next_report = t + interval;
+    }
+    stats.last_ = t;
+    ++stats.syscalls_;
+
+    for(int i = 0; i < n; ++i) {
+      const uint8_t* d = &bufs[i * UDPOUT_DGRAM_MAX];
+      size_t len = msgs[i].msg_len;
+
+      ++stats.datagrams_;
+
+      if(len % 188 == UDPOUT_RTP_HEADER && (d[0] >> 6) == 2) {
+        int seq = (d[2] << 8) | d[3];
+        if(rtp_seq >= 0)
+          stats.rtp_lost_ += (seq - rtp_seq - 1) & 0xFFFF;
+        rtp_seq = seq;
+        d += UDPOUT_RTP_HEADER;
+        len -= UDPOUT_RTP_HEADER;
+      }
+
+      for(size_t off = 0; off + TS_PACKET_SIZE <= len; off += TS_PACKET_SIZE) {
+        const uint8_t* p = d + off;
+        ++stats.packets_;
+        if(p[0] != TS_SYNC_BYTE)
+          ++stats.sync_errors_;
+        else if(!cc.check(p))
+          ++stats.cc_errors_;
+      }
+      stats.bytes_ += len;
+
+      if(output) {
+        for(size_t w = 0; w < len;) {
+          ssize_t r = write(STDOUT_FILENO, d + w, len - w);
+          if(r < 0) {
+            if(errno == EINTR) continue;
+            throw std::system_error(errno, std::system_category());
+          }
+          w += r;
+        }
+      }
+    }
+
+    if(interval > 0 && t >= next_report) {
+      report(stats);
+      next_report = t + interval;
+    }
+  }
+
+  report(stats);
+
+  return 0;
+}
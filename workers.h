@@ -0,0 +1,149 @@
+#ifndef _WORKERS_H_
+#define _WORKERS_H_
+
+#include <pthread.h>
+
+#include <vector>
+
+// A ring of jobs filled by one thread, processed by a pool of worker
+// threads and handed back to the filling thread in the order they were
+// submitted, so output built from them does not depend on which worker
+// was faster:
+//
+//	OrderedWorkers<Batch> pool(threads, depth, work, arg);
+//	for(;;) {
+//		while(Batch* b = pool.finished(pool.full())) { use(*b); pool.release(); }
+//		Batch& b = pool.next(); fill(b); pool.submit();
+//	}
+//	while(Batch* b = pool.finished(true)) { use(*b); pool.release(); }
+//
+// Jobs are reused from turn to turn, so their buffers keep their capacity.
+template<class Job>
+class OrderedWorkers {
+public:
+	// Runs on a worker thread, 'arg' is passed through
+	typedef void (*Work)(Job& job, void* arg);
+
+	OrderedWorkers(unsigned threads, unsigned depth, Work work, void* arg)
+		: jobs_(depth ? depth : 1), state_(jobs_.size(), FREE), work_(work), arg_(arg),
+		head_(0), tail_(0), queued_(0), stop_(false) {
+		pthread_mutex_init(&mutex_, 0);
+		pthread_cond_init(&work_ready_, 0);
+		pthread_cond_init(&job_done_, 0);
+
+		threads_.resize(threads ? threads : 1);
+		for(size_t i = 0; i < threads_.size(); ++i)
+			pthread_create(&threads_[i], 0, thread_func, this);
+	}
+
+	~OrderedWorkers() {
+		pthread_mutex_lock(&mutex_);
+		stop_ = true;
+		pthread_cond_broadcast(&work_ready_);
+		pthread_mutex_unlock(&mutex_);
+
+		for(size_t i = 0; i < threads_.size(); ++i)
+			pthread_join(threads_[i], 0);
+
+		pthread_cond_destroy(&job_done_);
+		pthread_cond_destroy(&work_ready_);
+		pthread_mutex_destroy(&mutex_);
+	}
+
+	// True if next() has no free job to give
+	bool full() const {
+		return tail_ - head_ == jobs_.size();
+	}
+
+	// True if no job is submitted and not yet released
+	bool empty() const {
+		return tail_ == head_;
+	}
+
+	// The job to fill; call only when !full()
+	Job& next() {
+		return jobs_[tail_ % jobs_.size()];
+	}
+
+	// Hands the job from next() to the workers
+	void submit() {
+		pthread_mutex_lock(&mutex_);
+		state_[tail_ % jobs_.size()] = QUEUED;
+		++tail_;
+		pthread_cond_signal(&work_ready_);
+		pthread_mutex_unlock(&mutex_);
+	}
+
+	// The oldest submitted job once it is processed, 0 if there is none or,
+	// unless 'wait' is set, if it is still being processed
+	Job* finished(bool wait) {
+		if(empty())
+			return 0;
+
+		size_t i = head_ % jobs_.size();
+		pthread_mutex_lock(&mutex_);
+		while(wait && state_[i] != DONE)
+			pthread_cond_wait(&job_done_, &mutex_);
+		bool done = state_[i] == DONE;
+		pthread_mutex_unlock(&mutex_);
+
+		return done ? &jobs_[i] : 0;
+	}
+
+	// Gives the job from finished() back to next()
+	void release() {
+		pthread_mutex_lock(&mutex_);
+		state_[head_ % jobs_.size()] = FREE;
+		pthread_mutex_unlock(&mutex_);
+		++head_;
+	}
+
+	unsigned threads() const { return threads_.size(); }
+
+private:
+	OrderedWorkers(OrderedWorkers const&);
+	OrderedWorkers& operator = (OrderedWorkers const&);
+
+	enum State { FREE, QUEUED, RUNNING, DONE };
+
+	static void* thread_func(void* arg) {
+		OrderedWorkers* this_ = reinterpret_cast<OrderedWorkers*>(arg);
+		pthread_mutex_lock(&this_->mutex_);
+		for(;;) {
+			while(!this_->stop_ && this_->queued_ == this_->tail_)
+				pthread_cond_wait(&this_->work_ready_, &this_->mutex_);
+			if(this_->queued_ == this_->tail_)
+				break;
+
+			size_t i = this_->queued_++ % this_->jobs_.size();
+			this_->state_[i] = RUNNING;
+			pthread_mutex_unlock(&this_->mutex_);
+
+			this_->work_(this_->jobs_[i], this_->arg_);
+
+			pthread_mutex_lock(&this_->mutex_);
+			this_->state_[i] = DONE;
+			pthread_cond_broadcast(&this_->job_done_);
+		}
+		pthread_mutex_unlock(&this_->mutex_);
+		return 0;
+	}
+
+	std::vector<Job> jobs_;
+	std::vector<State> state_;
+	Work work_;
+	void* arg_;
+
+	// jobs [head_, tail_) are submitted, [queued_, tail_) not yet taken by a worker
+	size_t head_;
+	size_t tail_;
+	size_t queued_;
+	bool stop_;
+
+	std::vector<pthread_t> threads_;
+	pthread_mutex_t mutex_;
+	pthread_cond_t work_ready_;
+	pthread_cond_t job_done_;
+};
+
+#endif